@@ -0,0 +1,263 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+using namespace glm;
+
+static BakerStats s_stats;
+
+BakerStats& baker_stats()
+{
+    return s_stats;
+}
+
+void baker_resetStats()
+{
+    for( auto& ns : s_stats.nanoseconds ) ns = 0;
+    s_stats.texels = 0;
+    s_stats.samples = 0;
+}
+
+static double s_previewSeconds = 0.0;
+static bool s_referenceSums = false;
+
+BAKER_TRACE_COUNTER( s_bytesWritten, "bytes written" );
+
+void baker_setPreviewInterval( double seconds )
+{
+    s_previewSeconds = seconds;
+}
+
+double baker_previewInterval()
+{
+    return s_previewSeconds;
+}
+
+void baker_setReferenceSums( bool enabled )
+{
+    s_referenceSums = enabled;
+}
+
+bool baker_referenceSums()
+{
+    return s_referenceSums;
+}
+
+// Previews are written quietly and left out of the stats, so they don't skew benchmarks of the final outputs.
+//
+static void baker_saveImage2D( const std::vector< vec4 >& pixels, int res, std::string outputFileName, int numChannels, bool preview )
+{
+    auto start = std::chrono::steady_clock::now();
+    auto lap = [&]( BakerStage stage ) {
+        auto now = std::chrono::steady_clock::now();
+        if ( !preview ) s_stats.nanoseconds[stage] += uint64_t( std::chrono::duration_cast< std::chrono::nanoseconds >( now - start ).count() );
+        start = now;
+    };
+
+    assert( numChannels >= 1 && numChannels <= 4 );
+    if ( baker_cancelled() ) {
+        return;
+    }
+
+    if ( !preview ) printf( "    Converting %s to uint8 ...\n", outputFileName.c_str() );
+    std::vector< uint8_t > pixels_u8;
+    {
+        BAKER_TRACE_SCOPE( "quantize" );
+        pixels_u8.resize( res * res * numChannels );
+        for( int i = 0; i < res; i++ ) {
+            for( int j = 0; j < res; j++ ) {
+                u8vec4 texel = glm::clamp( pixels[i * res + j], vec4( 0.0f ), vec4( 1.0f ) ) * 255.0f;
+                for( int c = 0; c < numChannels; c++ ) {
+                    pixels_u8[( i * res + j ) * numChannels + c] = texel[c];
+                }
+            }
+        }
+    }
+    lap( BAKER_STAGE_QUANTIZE );
+    
+    namespace fs = std::experimental::filesystem;
+    auto ext = fs::path( outputFileName ).extension().u8string();
+    
+    // Encoded in memory first, so encoding and file IO are timed apart.
+    std::vector< unsigned char > encoded;
+    auto append = []( void* context, void* data, int size ) {
+        auto bytes = static_cast< std::vector< unsigned char >* >( context );
+        bytes->insert( bytes->end(), static_cast< unsigned char* >( data ), static_cast< unsigned char* >( data ) + size );
+    };
+
+    if ( !preview ) printf( "    Writing %s ...\n", outputFileName.c_str() );
+    BAKER_TRACE_SCOPE( "encode and write" );
+    if ( ext == ".png" ) {
+        auto result = stbi_write_png_to_func( append, &encoded, res, res, numChannels, pixels_u8.data(), res * numChannels );
+        assert( result );
+    } else if ( ext == ".bmp" ) {
+        auto result = stbi_write_bmp_to_func( append, &encoded, res, res, numChannels, pixels_u8.data() );
+        assert( result );
+    } else if ( ext == ".tga" ) {
+        auto result = stbi_write_tga_to_func( append, &encoded, res, res, numChannels, pixels_u8.data() );
+        assert( result );
+    } else if ( ext == ".hdr" ) {
+        std::vector< float > pixels_f32;
+        pixels_f32.reserve( res * res * numChannels );
+        for( auto& texel : pixels ) {
+            pixels_f32.insert( pixels_f32.end(), &texel[0], &texel[0] + numChannels );
+        }
+        auto result = stbi_write_hdr_to_func( append, &encoded, res, res, numChannels, pixels_f32.data() );
+        assert( result );
+    } else {
+        assert( !" Unknown file format!" );
+    }
+    lap( BAKER_STAGE_ENCODE );
+
+    FILE* fp = fopen( outputFileName.c_str(), "wb" );
+    bool written = fp && fwrite( encoded.data(), 1, encoded.size(), fp ) == encoded.size();
+    if ( fp ) fclose( fp );
+    assert( written );
+    lap( BAKER_STAGE_WRITE );
+    BAKER_TRACE_COUNT( s_bytesWritten, encoded.size() );
+    if ( preview ) {
+        return;
+    }
+    s_stats.texels += uint64_t( res ) * uint64_t( res );
+    printf( "    Output to %s OK.\n\n", outputFileName.c_str() );
+}
+
+void baker_writeImage2D( const std::vector< vec4 >& pixels, int res, std::string outputFileName, int numChannels )
+{
+    baker_saveImage2D( pixels, res, outputFileName, numChannels, false );
+}
+
+// Rows are evaluated in parallel on the current pool; once cancelled, the rows not yet started are skipped.
+//
+void baker_evaluateImage2D( std::function< vec4( float x, float y ) > func, int res, std::vector< vec4 >& pixels )
+{
+    BAKER_TRACE_SCOPE( "evaluate image" );
+    pixels.resize( res * res );
+    baker_parallelFor( res, [&]( int i ) {
+        for( int j = 0; j < res; j++ ) {
+            float x = float( i ) / ( res - 1 );
+            float y = float( j ) / ( res - 1 );
+            pixels[i * res + j] = func( x, y );
+        }
+    } );
+}
+
+// Texels are evaluated a level at a time, each level the texels on a lattice of half the spacing of the last
+// that aren't on the coarser lattices, i.e. in bit-reversed order along both axes. Previews fill every texel
+// from the finest evaluated lattice point at or above and left of it, so they sharpen from blocks of the
+// coarsest spacing towards the full image.
+//
+void baker_evaluateImage2DProgressive( std::function< vec4( float x, float y ) > func, int res, std::vector< vec4 >& pixels,
+                                       double previewSeconds, BakerPreview preview )
+{
+    BAKER_TRACE_SCOPE( "evaluate image progressively" );
+    int coarsest = 1;
+    while ( coarsest * 2 < res ) coarsest *= 2;
+
+    std::vector< int > order;
+    order.reserve( res * res );
+    for( int spacing = coarsest; spacing >= 1; spacing /= 2 ) {
+        for( int i = 0; i < res; i += spacing ) {
+            for( int j = 0; j < res; j += spacing ) {
+                bool coarser = spacing < coarsest && i % ( spacing * 2 ) == 0 && j % ( spacing * 2 ) == 0;
+                if ( !coarser ) order.push_back( i * res + j );
+            }
+        }
+    }
+
+    pixels.assign( res * res, vec4( 0.0f ) );
+    std::vector< uint8_t > evaluated( res * res, 0 );
+    std::vector< vec4 > previewPixels;
+    auto lastPreview = std::chrono::steady_clock::now();
+    const int chunkSize = 4096;
+    for( int first = 0; first < int( order.size() ) && !baker_cancelled(); first += chunkSize ) {
+        int count = min( chunkSize, int( order.size() ) - first );
+        baker_parallelFor( count, [&]( int k ) {
+            int idx = order[first + k];
+            pixels[idx] = func( float( idx / res ) / ( res - 1 ), float( idx % res ) / ( res - 1 ) );
+            evaluated[idx] = 1;
+        } );
+
+        auto now = std::chrono::steady_clock::now();
+        bool last = first + count == int( order.size() );
+        if ( last || std::chrono::duration< double >( now - lastPreview ).count() < previewSeconds ) {
+            continue;
+        }
+        BAKER_TRACE_SCOPE( "preview" );
+        previewPixels.resize( res * res );
+        baker_parallelFor( res, [&]( int i ) {
+            for( int j = 0; j < res; j++ ) {
+                int source = i * res + j;
+                for( int spacing = 2; !evaluated[source] && spacing <= coarsest; spacing *= 2 ) {
+                    source = ( i - i % spacing ) * res + ( j - j % spacing );
+                }
+                previewPixels[i * res + j] = pixels[source];
+            }
+        } );
+        preview( previewPixels, float( first + count ) / float( order.size() ) );
+        lastPreview = std::chrono::steady_clock::now();
+    }
+}
+
+static std::string baker_previewFileName( std::string outputFileName )
+{
+    namespace fs = std::experimental::filesystem;
+    auto path = fs::path( outputFileName );
+    return ( path.parent_path() / ( path.stem().u8string() + ".preview" + path.extension().u8string() ) ).u8string();
+}
+
+void baker_writePreview2D( const std::vector< vec4 >& pixels, int res, std::string outputFileName, int numChannels, float fraction )
+{
+    auto previewFileName = baker_previewFileName( outputFileName );
+    printf( "    Preview %s at %d%% of texels.\n", previewFileName.c_str(), int( fraction * 100.0f ) );
+    baker_saveImage2D( pixels, res, previewFileName, numChannels, true );
+}
+
+void baker_removePreview2D( std::string outputFileName )
+{
+    std::error_code error;
+    std::experimental::filesystem::remove( baker_previewFileName( outputFileName ), error );
+}
+
+void baker_imageFunction2D( std::function< vec4( float x, float y ) > func, int res, std::string outputFileName )
+{
+    std::vector< vec4 > pixels;
+    
+    printf( "Baking 2D image table %s ...\n", outputFileName.c_str() );
+    if ( s_previewSeconds > 0.0 ) {
+        bool previewed = false;
+        baker_evaluateImage2DProgressive( func, res, pixels, s_previewSeconds, [&]( const std::vector< vec4 >& preview, float fraction ) {
+            baker_writePreview2D( preview, res, outputFileName, 4, fraction );
+            previewed = true;
+        } );
+        if ( previewed ) {
+            baker_removePreview2D( outputFileName );
+        }
+    } else {
+        baker_evaluateImage2D( func, res, pixels );
+    }
+
+    baker_writeImage2D( pixels, res, outputFileName );
+}
@@ -0,0 +1,212 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "bench.h"
+#include "env_brdf.h"
+#include "multiscatter_brdf.h"
+#include "gloss_normal.h"
+#include "blackbody.h"
+#include "subsurface.h"
+#include "noise.h"
+using namespace glm;
+
+#if defined( _WIN32 )
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment( lib, "psapi.lib" )
+#endif
+
+struct BenchBake
+{
+    const char* name;
+    std::function< void( BakeGraph& graph ) > bake;
+};
+
+struct BenchRun
+{
+    int numThreads;
+    double seconds;
+    double stageSeconds[BAKER_STAGE_COUNT];
+    uint64_t texels;
+    uint64_t samples;
+    uint64_t peakMemory;
+};
+
+static const BenchBake s_benchBakes[] = {
+    { "env_brdf", bake_envBRDF },
+    { "gloss_normal", bake_glossNormalTable },
+    { "blackbody", bake_blackBody },
+    { "subsurface", []( BakeGraph& graph ) { bake_subsurface( graph, PssProfileSettings() ); } },
+    { "noise", []( BakeGraph& graph ) { bake_noiseTextures( graph, NoiseSettings() ); } },
+    { "multiscatter_brdf", bake_multiscatterBRDF },
+};
+
+static const char* s_benchStageNames[BAKER_STAGE_COUNT] = { "quantize", "encode", "write" };
+
+// Peak resident memory in bytes. Linux lets the peak be reset between runs; on Windows it is the peak over the
+// whole process so far.
+//
+void bench_ResetPeakMemory()
+{
+#if defined( __linux__ )
+    FILE* fp = fopen( "/proc/self/clear_refs", "w" );
+    if ( fp ) {
+        fputs( "5", fp );
+        fclose( fp );
+    }
+#endif
+}
+
+uint64_t bench_PeakMemory()
+{
+#if defined( _WIN32 )
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) ) {
+        return uint64_t( counters.PeakWorkingSetSize );
+    }
+#elif defined( __linux__ )
+    FILE* fp = fopen( "/proc/self/status", "r" );
+    if ( fp ) {
+        char line[256];
+        unsigned long long kb = 0;
+        while ( fgets( line, sizeof( line ), fp ) ) {
+            if ( sscanf( line, "VmHWM: %llu kB", &kb ) == 1 ) break;
+        }
+        fclose( fp );
+        return uint64_t( kb ) * 1024;
+    }
+#endif
+    return 0;
+}
+
+BenchRun bench_Run( const BenchBake& bake, int numThreads )
+{
+    baker_setNumThreads( numThreads );
+    baker_resetStats();
+    bench_ResetPeakMemory();
+
+    BakeGraph graph;
+    bake.bake( graph );
+    auto start = std::chrono::steady_clock::now();
+    baker_runGraph( graph );
+    auto end = std::chrono::steady_clock::now();
+
+    BenchRun run;
+    run.numThreads = numThreads;
+    run.seconds = std::chrono::duration< double >( end - start ).count();
+    for( int i = 0; i < BAKER_STAGE_COUNT; i++ ) {
+        run.stageSeconds[i] = double( baker_stats().nanoseconds[i] ) * 1e-9;
+    }
+    run.texels = baker_stats().texels;
+    run.samples = baker_stats().samples;
+    run.peakMemory = bench_PeakMemory();
+    return run;
+}
+
+// Everything not spent quantizing, encoding or writing images is evaluation. Stage times are summed over jobs
+// running concurrently, so on several threads this is a lower bound.
+double bench_EvaluateSeconds( const BenchRun& run )
+{
+    double seconds = run.seconds;
+    for( int i = 0; i < BAKER_STAGE_COUNT; i++ ) seconds -= run.stageSeconds[i];
+    return max( seconds, 0.0 );
+}
+
+// Times each bake end to end at every thread count, keeping the fastest of a few runs, and breaks the time down
+// into evaluation and the stages of the image output path. Bakes write their usual outputs while being timed.
+// The report is a JSON file, one entry per bake and thread count, for tracking across builds.
+//
+void bake_benchmark( const BenchSettings& settings )
+{
+    int hardwareThreads = max( 1, int( std::thread::hardware_concurrency() ) );
+    std::vector< int > threadCounts = settings.threadCounts;
+    if ( !threadCounts.size() ) {
+        for( int n = 1; n < hardwareThreads; n *= 2 ) threadCounts.push_back( n );
+        threadCounts.push_back( hardwareThreads );
+    }
+    int repeats = max( 1, settings.repeats );
+
+    std::vector< const BenchBake* > bakes;
+    for( auto& name : settings.bakes ) {
+        bool found = false;
+        for( auto& bake : s_benchBakes ) {
+            if ( name == "all" || name == bake.name ) {
+                bakes.push_back( &bake );
+                found = true;
+            }
+        }
+        if ( !found ) printf( "Unknown bake %s, skipping.\n", name.c_str() );
+    }
+
+    std::vector< std::vector< BenchRun > > results;
+    for( auto bake : bakes ) {
+        results.emplace_back();
+        for( int numThreads : threadCounts ) {
+            BenchRun best;
+            for( int r = 0; r < repeats; r++ ) {
+                printf( "Benchmarking %s on %d threads, run %d / %d ...\n", bake->name, numThreads, r + 1, repeats );
+                BenchRun run = bench_Run( *bake, numThreads );
+                if ( r == 0 || run.seconds < best.seconds ) best = run;
+            }
+            results.back().push_back( best );
+        }
+    }
+    baker_setNumThreads( 0 );
+
+    FILE* fp = fopen( settings.outputFileName.c_str(), "w" );
+    if ( !fp ) {
+        printf( "Failed to open %s.\n", settings.outputFileName.c_str() );
+    } else {
+        fprintf( fp, "{\n  \"hardware_threads\": %d,\n  \"repeats\": %d,\n  \"bakes\": [\n", hardwareThreads, repeats );
+        for( size_t b = 0; b < bakes.size(); b++ ) {
+            fprintf( fp, "    {\n      \"name\": \"%s\",\n      \"runs\": [\n", bakes[b]->name );
+            for( size_t i = 0; i < results[b].size(); i++ ) {
+                const BenchRun& run = results[b][i];
+                fprintf( fp, "        { \"threads\": %d, \"seconds\": %.6f, \"evaluate_seconds\": %.6f", run.numThreads, run.seconds,
+                         bench_EvaluateSeconds( run ) );
+                for( int s = 0; s < BAKER_STAGE_COUNT; s++ ) {
+                    fprintf( fp, ", \"%s_seconds\": %.6f", s_benchStageNames[s], run.stageSeconds[s] );
+                }
+                fprintf( fp, ", \"texels\": %llu, \"samples\": %llu, \"texels_per_second\": %.1f, \"samples_per_second\": %.1f",
+                         (unsigned long long)run.texels, (unsigned long long)run.samples, double( run.texels ) / run.seconds,
+                         double( run.samples ) / run.seconds );
+                fprintf( fp, ", \"peak_memory_bytes\": %llu, \"speedup\": %.3f }%s\n", (unsigned long long)run.peakMemory,
+                         results[b][0].seconds / run.seconds, i + 1 < results[b].size() ? "," : "" );
+            }
+            fprintf( fp, "      ]\n    }%s\n", b + 1 < bakes.size() ? "," : "" );
+        }
+        fprintf( fp, "  ]\n}\n" );
+        fclose( fp );
+        printf( "Report written to %s.\n", settings.outputFileName.c_str() );
+    }
+
+    printf( "\n%-18s %7s %10s %10s %10s %10s %10s %12s %12s %8s %8s\n", "bake", "threads", "seconds", "evaluate", "quantize",
+            "encode", "write", "texels/s", "samples/s", "peak MB", "speedup" );
+    for( size_t b = 0; b < bakes.size(); b++ ) {
+        for( auto& run : results[b] ) {
+            printf( "%-18s %7d %10.4f %10.4f %10.4f %10.4f %10.4f %12.4g %12.4g %8.1f %8.2f\n", bakes[b]->name, run.numThreads,
+                    run.seconds, bench_EvaluateSeconds( run ), run.stageSeconds[BAKER_STAGE_QUANTIZE], run.stageSeconds[BAKER_STAGE_ENCODE],
+                    run.stageSeconds[BAKER_STAGE_WRITE], double( run.texels ) / run.seconds, double( run.samples ) / run.seconds,
+                    double( run.peakMemory ) / ( 1024.0 * 1024.0 ), results[b][0].seconds / run.seconds );
+        }
+    }
+    printf( "\n" );
+}
@@ -20,10 +20,6 @@
 #include "common.h"
 #include "blackbody.h"
 
-#include <iostream>
-#include <unordered_map>
-#include <csv-parser/parser.hpp>
-
 using namespace glm;
 
 // ref: https://www.shadertoy.com/view/4tVBWW
@@ -86,36 +82,41 @@ vec4 blackbody_Tonemap( vec4 val )
     return clamp( blackbody_Tonemap_Unclamped( val ), 0.0f, 1.0f );
 }
 
-// ref: https://www.shadertoy.com/view/4tVBWW
-//
-vec4 blackbody_Integrate_Cached( float temperature )
+template< typename Sum >
+vec3 blackbody_IntegrateXYZ( float temperature, int numSamples )
 {
-    static std::unordered_map< float, vec4 > s_cache;
-    if ( s_cache.find( temperature ) != s_cache.end() ) {
-        return s_cache[ temperature ];
-    }
-    const int NUM_SAMPLES = 10000;
-
-    vec3 XYZ;
-    for( int i = 0; i < NUM_SAMPLES; i++ ) {
-        double wavelen = mix( 380.0f, 720.0f, double( i ) / double( NUM_SAMPLES - 1 ) );
+    Sum XYZ;
+    for( int i = 0; i < numSamples; i++ ) {
+        double wavelen = mix( 380.0f, 720.0f, double( i ) / double( numSamples - 1 ) );
         auto L = double( blackbody_PlancksLaw( wavelen, temperature ) );
-        XYZ += nvFit_XYZ10( wavelen ) * float( L );
+        XYZ.add( nvFit_XYZ10( wavelen ) * float( L ) );
     }
-    XYZ /= NUM_SAMPLES;
+    baker_countSamples( numSamples );
+    return XYZ.value() / float( numSamples );
+}
 
+// ref: https://www.shadertoy.com/view/4tVBWW
+//
+vec4 blackbody_IntegrateTemperature( float temperature, int numSamples )
+{
+    auto XYZ = baker_referenceSums() ? blackbody_IntegrateXYZ< BakerDoubleSum< vec3 > >( temperature, numSamples )
+                                     : blackbody_IntegrateXYZ< BakerSum< vec3 > >( temperature, numSamples );
     auto c = XYZ_to_sRGB_D50( XYZ );
-
-    printf( "    temperature %.0fK RGB = %f %f %f XYZ = %f %f %f\n", temperature, c.r, c.g, c.b, XYZ.x, XYZ.y, XYZ.z );
-
-    s_cache[ temperature ] = vec4( c, 1.0f );
-    return s_cache[ temperature ];
+    return vec4( c, 1.0f );
 }
 
-vec4 blackbody_Integrate( float x, float y )
+// Dense 1D table of integrated colour over temperature in [1000K, 20000K], one entry per texel.
+//
+std::vector< vec4 > blackbody_IntegrateTemperatureCurve( int res, int numSamples )
 {
-    float temperature = mix( 1000, 20000, y );
-    return blackbody_Tonemap( blackbody_Integrate_Cached( temperature ) );
+    BAKER_TRACE_SCOPE( "integrate blackbody curve" );
+    printf( "    Integrating %d blackbody temperatures ...\n", res );
+    std::vector< vec4 > curve( res );
+    baker_parallelFor( res, [&]( int i ) {
+        float temperature = mix( 1000, 20000, float( i ) / float( res - 1 ) );
+        curve[i] = blackbody_IntegrateTemperature( temperature, numSamples );
+    } );
+    return curve;
 }
 
 void blackbody_GraphPlanck()
@@ -153,12 +154,13 @@ void blackbody_GraphSRGB()
 
     bool IMPORTANCE_SAMPLE = true;
     const int NUM_TEMPERATURE_SAMPLES = 1024;
+    auto curve = blackbody_IntegrateTemperatureCurve( NUM_TEMPERATURE_SAMPLES, BLACKBODY_SAMPLE_SIZE );
 
     for( int i = 0; i < NUM_TEMPERATURE_SAMPLES; i++ ) {
         float y = float( i ) / float( NUM_TEMPERATURE_SAMPLES - 1 );
         float temperature = mix( 1000, 20000, y );
 
-        vec4 c = blackbody_Integrate_Cached( temperature );
+        vec4 c = curve[i];
         vec3 cf = blackbody_FitSRGB( temperature );
 
         auto signc = sign( c ); c = abs( c );
@@ -172,9 +174,32 @@ void blackbody_GraphSRGB()
     fclose( fp );
 }
 
-void bake_blackBody()
+// Temperature only varies along y, so bake the curve once and copy it into every row.
+//
+void blackbody_EvaluateImage( int res, int numSamples, std::vector< vec4 >& pixels )
+{
+    auto curve = blackbody_IntegrateTemperatureCurve( res, numSamples );
+    for( auto& c : curve ) {
+        c = blackbody_Tonemap( c );
+    }
+
+    pixels.resize( res * res );
+    for( int i = 0; i < res; i++ ) {
+        std::copy( curve.begin(), curve.end(), pixels.begin() + i * res );
+    }
+}
+
+void blackbody_BakeImage( int res, std::string outputFileName )
+{
+    printf( "Baking 2D image table %s ...\n", outputFileName.c_str() );
+    std::vector< vec4 > pixels;
+    blackbody_EvaluateImage( res, BLACKBODY_SAMPLE_SIZE, pixels );
+    baker_writeImage2D( pixels, res, outputFileName );
+}
+
+void bake_blackBody( BakeGraph& graph )
 {
-    blackbody_GraphPlanck();
-    blackbody_GraphSRGB();
-    baker_imageFunction2D( blackbody_Integrate, 256, "output/planck_blackbody.png" );
+    baker_addJob( graph, "planck_5k", blackbody_GraphPlanck );
+    baker_addJob( graph, "planck_srgb", blackbody_GraphSRGB );
+    baker_addJob( graph, "planck_blackbody", []() { blackbody_BakeImage( 256, "output/planck_blackbody.png" ); } );
 }
\ No newline at end of file
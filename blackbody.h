@@ -20,4 +20,12 @@
 #pragma once
 #include "common.h"
 
-void bake_blackBody();
\ No newline at end of file
+#define BLACKBODY_SAMPLE_SIZE 10000
+
+glm::vec3 nvFit_XYZ10( float l );
+glm::vec3 XYZ_to_sRGB_D50( glm::vec3 XYZ );
+
+// Tonemapped colour of temperatures in [1000K, 20000K] along y, each integrated over numSamples wavelengths.
+void blackbody_EvaluateImage( int res, int numSamples, std::vector< glm::vec4 >& pixels );
+
+void bake_blackBody( BakeGraph& graph );
\ No newline at end of file
@@ -25,9 +25,16 @@
 #include <cmath>
 #include <functional>
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
 
 #include <glm/glm.hpp>
 
+#include "trace.h"
+
 #define PI 3.141596535f
 #define EPS 0.00001f
 
@@ -38,4 +45,156 @@ inline float saturate( float x )
     return x;
 }
 
-void baker_imageFunction2D( std::function< glm::vec4( float x, float y ) > func, int res, std::string outputFileName );
\ No newline at end of file
+// Counter-based random numbers. Each value is a pure function of its inputs, so bakes are reproducible and any
+// texel can be generated on its own, on any thread.
+//
+// ref: "Hash Functions for GPU Rendering" by Jarzynski and Olano ( PCG hash )
+//
+inline uint32_t baker_hash( uint32_t x )
+{
+    uint32_t state = x * 747796405u + 2891336453u;
+    uint32_t word = ( ( state >> ( ( state >> 28u ) + 4u ) ) ^ state ) * 277803737u;
+    return ( word >> 22u ) ^ word;
+}
+
+inline uint32_t baker_hash( uint32_t seed, uint32_t x, uint32_t y, uint32_t channel )
+{
+    return baker_hash( baker_hash( baker_hash( baker_hash( seed ) + x ) + y ) + channel );
+}
+
+// Uniform in [ 0, 1 ).
+inline float baker_random( uint32_t seed, uint32_t x, uint32_t y, uint32_t channel )
+{
+    return float( baker_hash( seed, x, y, channel ) >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+// Compensated ( Kahan ) summation for the integrators. A plain float sum of N terms drifts by up to N ulps, which
+// at the larger sample counts reaches the 8 bit and 16 bit quantization step; carrying the rounding error of each
+// add keeps the result within a couple of ulps of the exact sum, whatever N. Works for floats and glm vectors,
+// componentwise. Relies on strict float semantics: /fp:fast or -ffast-math folds the compensation away.
+//
+// ref: "Further remarks on reducing truncation errors" by Kahan
+//
+template< typename T >
+struct BakerSum
+{
+    T sum = T( 0.0f );
+    T compensation = T( 0.0f );
+
+    void add( T x )
+    {
+        T y = x - compensation;
+        T t = sum + y;
+        compensation = ( t - sum ) - y;
+        sum = t;
+    }
+
+    T value() const { return sum; }
+};
+
+// Exact enough sums for reference bakes. With baker_setReferenceSums on, the integrators accumulate every sample
+// in double precision instead, so verify can measure how far the float sums are from the exact ones. Off by
+// default; set it before baking.
+//
+template< typename T > struct BakerWide { typedef double type; };
+template<> struct BakerWide< glm::vec3 > { typedef glm::dvec3 type; };
+
+template< typename T >
+struct BakerDoubleSum
+{
+    typename BakerWide< T >::type sum = typename BakerWide< T >::type( 0.0 );
+
+    void add( T x ) { sum += typename BakerWide< T >::type( x ); }
+    T value() const { return T( sum ); }
+};
+
+void baker_setReferenceSums( bool enabled );
+bool baker_referenceSums();
+
+// Runs func( idx ) for idx in [0, count) on the shared pool of baker_numThreads() threads, all hardware threads
+// by default. Safe to nest, and to call from bake jobs.
+void baker_parallelFor( int count, std::function< void( int idx ) > func );
+void baker_setNumThreads( int numThreads ); // 0 for all hardware threads.
+int baker_numThreads();
+
+// Separate pools for embedders. baker_withPool runs func on the calling thread with every loop and job it starts
+// going to pool instead, and with cancel checked by baker_cancelled() on every thread working for it. Cancelled
+// loops skip their remaining indices and cancelled graphs their remaining jobs; long bakes also check it and
+// stop early, keeping checkpoints, and no images are written once cancelled. Seen is set the first time
+// baker_cancelled() returns true for the bake, so a cancel that came after its last check, with nothing skipped,
+// can be told apart from one that cut it short.
+struct BakerCancel
+{
+    std::atomic< bool > requested{ false };
+    std::atomic< bool > seen{ false };
+};
+
+struct BakerThreadPool;
+BakerThreadPool* baker_createPool( int numThreads ); // 0 for all hardware threads.
+void baker_destroyPool( BakerThreadPool* pool );
+void baker_withPool( BakerThreadPool* pool, BakerCancel* cancel, std::function< void() > func );
+bool baker_cancelled();
+
+// A DAG of bake jobs. Each job runs on the shared pool as soon as every job it depends on is done, concurrently
+// with anything else that is ready. Dependencies must be jobs added earlier, so the graph can't have cycles.
+//
+struct BakeJob
+{
+    std::string name;
+    std::function< void() > func;
+    std::vector< int > dependencies;
+};
+
+struct BakeGraph
+{
+    std::vector< BakeJob > jobs;
+};
+
+int baker_addJob( BakeGraph& graph, std::string name, std::function< void() > func, std::vector< int > dependencies = {} );
+void baker_runGraph( const BakeGraph& graph );
+
+// Time spent in each stage of the shared image output path, and work done by the integrators. Accumulated from
+// any thread; the benchmark resets and reads them around each bake.
+enum BakerStage
+{
+    BAKER_STAGE_QUANTIZE,
+    BAKER_STAGE_ENCODE,
+    BAKER_STAGE_WRITE,
+    BAKER_STAGE_COUNT
+};
+
+struct BakerStats
+{
+    std::atomic< uint64_t > nanoseconds[BAKER_STAGE_COUNT];
+    std::atomic< uint64_t > texels;  // Written to images.
+    std::atomic< uint64_t > samples; // Taken by numerical integrators.
+};
+
+BakerStats& baker_stats();
+void baker_resetStats();
+
+inline void baker_countSamples( uint64_t count )
+{
+    baker_stats().samples += count;
+}
+
+// Images are stored row-major, texel [i * res + j] at x = i / ( res - 1 ), y = j / ( res - 1 ). The first
+// numChannels channels of each texel are written.
+void baker_writeImage2D( const std::vector< glm::vec4 >& pixels, int res, std::string outputFileName, int numChannels = 4 );
+void baker_evaluateImage2D( std::function< glm::vec4( float x, float y ) > func, int res, std::vector< glm::vec4 >& pixels );
+void baker_imageFunction2D( std::function< glm::vec4( float x, float y ) > func, int res, std::string outputFileName );
+
+// Progressive evaluation, for looking at long bakes early. The coarsest texels are evaluated first and refined in
+// between, and preview is called with the image so far, gaps filled from nearby texels, whenever previewSeconds
+// have passed. Func is called from the pool's threads at once, and pixels ends up exactly as baker_evaluateImage2D
+// leaves it.
+typedef std::function< void( const std::vector< glm::vec4 >& pixels, float fraction ) > BakerPreview;
+void baker_evaluateImage2DProgressive( std::function< glm::vec4( float x, float y ) > func, int res, std::vector< glm::vec4 >& pixels,
+                                       double previewSeconds, BakerPreview preview );
+
+// With an interval above 0, baker_imageFunction2D and manifest bakes evaluate progressively, keeping
+// <output>.preview<ext> up to date until the output is written. Off by default.
+void baker_setPreviewInterval( double seconds );
+double baker_previewInterval();
+void baker_writePreview2D( const std::vector< glm::vec4 >& pixels, int res, std::string outputFileName, int numChannels, float fraction );
+void baker_removePreview2D( std::string outputFileName );
\ No newline at end of file
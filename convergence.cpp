@@ -0,0 +1,179 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "convergence.h"
+#include "env_brdf.h"
+#include "gloss_normal.h"
+
+#include <memory>
+
+using namespace glm;
+
+#define CONVERGENCE_LSB ( 1.0 / 255.0 )
+
+struct ConvergenceTable
+{
+    const char* name;
+    int numChannels;
+    bool is1D;          // 256 entries along x.
+    int defaultSamples;
+    std::function< vec4( float x, float y, int numSamples, uint32_t scramble ) > integrate;
+};
+
+static const ConvergenceTable s_convergenceTables[] = {
+    { "env_brdf", 2, false, ENVBRDF_SAMPLE_SIZE, []( float x, float y, int numSamples, uint32_t scramble ) {
+        return ggx_IntegrateBRDF_Function( x, y, false, numSamples, scramble ); } },
+    { "env_brdf_multiscatter", 2, false, ENVBRDF_SAMPLE_SIZE, []( float x, float y, int numSamples, uint32_t scramble ) {
+        return ggx_IntegrateBRDF_Function( x, y, true, numSamples, scramble ); } },
+    { "gloss_normal_length", 1, true, GLOSSNORMAL_SAMPLE_SIZE, []( float x, float /*y*/, int numSamples, uint32_t scramble ) {
+        return vec4( glossNormal_IntegrateGlossNormalGGX( x, numSamples, scramble ) ); } },
+};
+
+struct ConvergenceRun
+{
+    int numSamples;
+    double maxError;    // In 8-bit steps.
+    double rmsError;
+    double overHalfStep; // Fraction of texels.
+    double seconds;
+};
+
+// Standard deviation over scrambles of each texel's estimate, the largest of its channels.
+//
+std::vector< float > convergence_TexelErrors( const ConvergenceTable& table, int res, int numSamples, const ConvergenceSettings& settings )
+{
+    int width = table.is1D ? 256 : res;
+    int height = table.is1D ? 1 : res;
+    std::vector< float > errors( width * height );
+    baker_parallelFor( width * height, [&]( int idx ) {
+        int i = idx / height;
+        int j = idx % height;
+        float x = float( i ) / ( width - 1 );
+        float y = height > 1 ? float( j ) / ( height - 1 ) : 0.0f;
+        dvec4 sum( 0.0 ), sumSquares( 0.0 );
+        for( int s = 0; s < settings.numScrambles; s++ ) {
+            dvec4 estimate = dvec4( table.integrate( x, y, numSamples, baker_hash( settings.seed, uint32_t( s ), 0, 0 ) | 1u ) );
+            sum += estimate;
+            sumSquares += estimate * estimate;
+        }
+        double n = double( settings.numScrambles );
+        dvec4 variance = max( ( sumSquares - sum * sum / n ) / ( n - 1.0 ), dvec4( 0.0 ) );
+        double error = 0.0;
+        for( int c = 0; c < table.numChannels; c++ ) error = max( error, sqrt( variance[c] ) );
+        errors[i * height + j] = float( error );
+    } );
+    return errors;
+}
+
+// Green below half an 8-bit step, through yellow at half a step to red at two steps.
+//
+vec4 convergence_HeatColour( double steps )
+{
+    float t = float( steps / 0.5 );
+    if ( t < 1.0f ) {
+        return vec4( t, 1.0f, 0.0f, 1.0f );
+    }
+    return vec4( 1.0f, glm::clamp( 1.0f - ( t - 1.0f ) / 3.0f, 0.0f, 1.0f ), 0.0f, 1.0f );
+}
+
+void bake_convergence( BakeGraph& graph, const ConvergenceSettings& settings )
+{
+    std::vector< const ConvergenceTable* > tables;
+    for( auto& name : settings.tables ) {
+        bool found = false;
+        for( auto& table : s_convergenceTables ) {
+            if ( name == "all" || name == table.name ) {
+                tables.push_back( &table );
+                found = true;
+            }
+        }
+        if ( !found ) printf( "Unknown Monte Carlo table %s, skipping.\n", name.c_str() );
+    }
+    if ( settings.numScrambles < 2 || settings.res < 2 ) {
+        printf( "Error estimates need at least 2 scrambles and a resolution of 2, skipping.\n" );
+        return;
+    }
+
+    auto results = std::make_shared< std::vector< std::vector< ConvergenceRun > > >( tables.size() );
+    std::vector< int > tableJobs;
+    for( int t = 0; t < int( tables.size() ); t++ ) {
+        auto table = tables[t];
+        tableJobs.push_back( baker_addJob( graph, std::string( "convergence " ) + table->name, [=]() {
+            for( int numSamples : settings.sampleCounts ) {
+                if ( numSamples < 1 || baker_cancelled() ) continue;
+                printf( "Estimating %s error at %d samples over %d scrambles ...\n", table->name, numSamples, settings.numScrambles );
+                auto start = std::chrono::steady_clock::now();
+                auto errors = convergence_TexelErrors( *table, settings.res, numSamples, settings );
+
+                ConvergenceRun run = { numSamples, 0.0, 0.0, 0.0, 0.0 };
+                for( float error : errors ) {
+                    double steps = error / CONVERGENCE_LSB;
+                    run.maxError = max( run.maxError, steps );
+                    run.rmsError += steps * steps;
+                    run.overHalfStep += steps > 0.5 ? 1.0 : 0.0;
+                }
+                run.rmsError = sqrt( run.rmsError / errors.size() );
+                run.overHalfStep /= errors.size();
+                run.seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+                ( *results )[t].push_back( run );
+
+                if ( !table->is1D ) {
+                    std::vector< vec4 > heatmap( errors.size() );
+                    for( size_t i = 0; i < errors.size(); i++ ) {
+                        heatmap[i] = convergence_HeatColour( errors[i] / CONVERGENCE_LSB );
+                    }
+                    baker_writeImage2D( heatmap, settings.res, "output/" + std::string( table->name ) + "_error_" + std::to_string( numSamples ) + ".png" );
+                }
+            }
+        } ) );
+    }
+
+    baker_addJob( graph, "convergence report", [=]() {
+        FILE* fp = fopen( settings.outputFileName.c_str(), "w" );
+        if ( !fp ) {
+            printf( "Failed to open %s.\n", settings.outputFileName.c_str() );
+            return;
+        }
+        fprintf( fp, "{\n  \"scrambles\": %d,\n  \"resolution\": %d,\n  \"tables\": [\n", settings.numScrambles, settings.res );
+        for( size_t t = 0; t < tables.size(); t++ ) {
+            auto& runs = ( *results )[t];
+            int recommended = 0;
+            for( auto& run : runs ) {
+                if ( run.maxError <= 0.5 && ( !recommended || run.numSamples < recommended ) ) recommended = run.numSamples;
+            }
+            if ( recommended ) {
+                printf( "%s: %d samples keep every texel within half an 8-bit step, %d are baked.\n", tables[t]->name, recommended, tables[t]->defaultSamples );
+            } else {
+                printf( "%s: no sample count tried keeps every texel within half an 8-bit step.\n", tables[t]->name );
+            }
+
+            fprintf( fp, "    {\n      \"name\": \"%s\",\n      \"baked_samples\": %d,\n      \"recommended_samples\": %d,\n      \"runs\": [\n",
+                     tables[t]->name, tables[t]->defaultSamples, recommended );
+            for( size_t r = 0; r < runs.size(); r++ ) {
+                fprintf( fp, "        { \"samples\": %d, \"max_error_lsb\": %.4f, \"rms_error_lsb\": %.4f, \"texels_over_half_lsb\": %.4f, \"seconds\": %.3f }%s\n",
+                         runs[r].numSamples, runs[r].maxError, runs[r].rmsError, runs[r].overHalfStep, runs[r].seconds, r + 1 < runs.size() ? "," : "" );
+            }
+            fprintf( fp, "      ]\n    }%s\n", t + 1 < tables.size() ? "," : "" );
+        }
+        fprintf( fp, "  ]\n}\n" );
+        fclose( fp );
+        printf( "Report written to %s.\n", settings.outputFileName.c_str() );
+    }, tableJobs );
+}
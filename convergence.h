@@ -0,0 +1,40 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+
+// Error estimates for the Monte Carlo integrated tables, to find the fewest samples that still bake them exactly
+// at 8 bits. Hammersley points aren't random, so a single bake has no variance to measure; instead every texel is
+// integrated numScrambles times with independently Owen scrambled points ( randomized QMC ), and the spread of
+// those estimates is the error of one bake at that sample count.
+//
+struct ConvergenceSettings
+{
+    std::vector< std::string > tables;  // env_brdf, env_brdf_multiscatter, gloss_normal_length or all.
+    std::vector< int > sampleCounts = { 64, 256, 1024, 4096 };
+    int numScrambles = 8;
+    int res = 64;                       // Of 2D tables, 1D tables keep their size.
+    uint32_t seed = 0;
+    std::string outputFileName = "output/convergence.json";
+};
+
+// Writes a JSON report of the error of each table at each sample count, in 8-bit steps, with the smallest count
+// that keeps every texel within half a step, and error heatmaps output/<table>_error_<samples>.png of 2D tables.
+void bake_convergence( BakeGraph& graph, const ConvergenceSettings& settings );
@@ -18,17 +18,11 @@
 */
 
 #include "env_brdf.h"
+#include "sampling.h"
 using namespace glm;
 
-#include <hammersley/hammersley.h>
-#include <hammersley/hammersley.c>
-
-#define ENVBRDF_SAMPLE_SIZE 1024
-#define HAMMERSLEY_SEQUENCE_M 2
 #define TEST_HAMMERSLEY false
 
-static bool MULTISCATTER_ENVBRDF = false;
-
 // Gloss parameterization similar to Call of Duty: Advanced Warfare
 //
 float ggx_GlossToAlpha2( float gloss )
@@ -49,29 +43,24 @@ vec3 ggx_ImportanceSampleGGX( vec2 xi, float alpha2, vec3 N )
     vec3 tangentY = cross( N, tangentX );    return tangentX * H.x + tangentY * H.y + N * H.z;
 }
 
-// src: https://people.sc.fsu.edu/~jburkardt/cpp_src/hammersley/hammersley.html
+// Evaluated directly by bit reversal, so it is safe to call from any thread.
 //
 vec2 noise_getHammersleyAtIdx( int idx, int N )
 {
-    static std::vector< vec2 > hmValues;
-
-    if ( hmValues.size() != N ) {
-
-        // Pre-calculate hammersley sequence.
-
-        hmValues.resize( N );
-        auto v = hammersley_sequence( 0, N, HAMMERSLEY_SEQUENCE_M, N );
-        assert( v );
+    return sampling_Hammersley2D( idx % N, N );
+}
 
-        for( int i = 0; i < N; i++ )
-        {
-            hmValues[i].x = v[i * 2 + 0];
-            hmValues[i].y = v[i * 2 + 1];
-        }
-        free( v );
+// Scrambling each dimension keeps every power of two sample count a ( 0, m, 2 )-net.
+//
+vec2 noise_getHammersleyAtIdx( int idx, int N, uint32_t scramble )
+{
+    if ( !scramble ) {
+        return noise_getHammersleyAtIdx( idx, N );
     }
-
-    return hmValues[ idx % N ];
+    uint32_t i = uint32_t( idx % N );
+    uint32_t x = sampling_OwenScramble( sampling_Hammersley( i, 0, N ), baker_hash( scramble, 0, 0, 0 ) );
+    uint32_t y = sampling_OwenScramble( sampling_ReverseBits( i ), baker_hash( scramble, 0, 0, 1 ) );
+    return vec2( sampling_ToFloat( x ), sampling_ToFloat( y ) );
 }
 
 // src: https://schuttejoe.github.io/post/ggximportancesamplingpart1/
@@ -83,10 +72,18 @@ float ggx_SmithGeom( float NdotL, float NdotV, float alpha2 )
     return 2.0f * NdotL * NdotV / ( denomA + denomB );
 }
 
+BAKER_TRACE_COUNTER( s_rejectedSamples, "ggx rejected samples" );
+
+// One instantiation per sample count and variant, so the loop bound, the point spacing and the multiscatter
+// select are compile time constants, and unscrambled points skip the scramble. fixedSamples 0 is the generic
+// kernel, taking the count at run time. Sum is BakerSum, or BakerDoubleSum for reference bakes.
+//
 // src : https://cdn2.unrealengine.com/Resources/files/2013SiggraphPresentationsNotes-26915738.pdf
 //
-vec2 ggx_IntegrateBRDF( float alpha, float NdotV )
+template< int fixedSamples, bool multiscatter, bool scrambled, typename Sum >
+vec2 ggx_IntegrateBRDFKernel( float alpha, float NdotV, int runtimeSamples, uint32_t scramble )
 {
+    const int numSamples = fixedSamples ? fixedSamples : runtimeSamples;
     vec3 V = vec3(
         sqrt( 1.0f - NdotV * NdotV ), // sin
         0.0f,
@@ -94,13 +91,13 @@ vec2 ggx_IntegrateBRDF( float alpha, float NdotV )
     );
     vec3 N = vec3( 0, 0, 1 );
 
-    float A = 0.0;
-    float B = 0.0;
+    Sum A, B;
     float alpha2 = alpha * alpha;
+    int rejected = 0;
 
-    for( uint i = 0; i < ENVBRDF_SAMPLE_SIZE; i++ )
+    for( int i = 0; i < numSamples; i++ )
     {
-        auto xi = noise_getHammersleyAtIdx( i, ENVBRDF_SAMPLE_SIZE );
+        auto xi = scrambled ? noise_getHammersleyAtIdx( i, numSamples, scramble ) : sampling_Hammersley2D( i, numSamples );
         auto H = ggx_ImportanceSampleGGX( xi, alpha2, N );
         vec3 L = 2.0f * dot( V, H ) * H - V;
 
@@ -112,20 +109,65 @@ vec2 ggx_IntegrateBRDF( float alpha, float NdotV )
             float G = ggx_SmithGeom( NdotL, NdotV, alpha2 );
             float Gvis = G * VdotH / ( NdotH * NdotV );
             float Fc = pow( 1 - VdotH, 5.0f );
-            A += ( 1 - Fc ) * Gvis;
-            B += ( MULTISCATTER_ENVBRDF ? 1.0f : Fc ) * Gvis;            // printf( "x %f y %f i %d = { A %f B %f G %f Gvis %f Fc %f } { NdotH %f NdotV %f } \n", gloss, NdotV, i, A, B, G, Gvis, Fc, NdotH, NdotV );
+            A.add( ( 1 - Fc ) * Gvis );
+            B.add( ( multiscatter ? 1.0f : Fc ) * Gvis );            // printf( "x %f y %f i %d = { A %f B %f G %f Gvis %f Fc %f } { NdotH %f NdotV %f } \n", gloss, NdotV, i, A, B, G, Gvis, Fc, NdotH, NdotV );
+        } else {
+            rejected++;
         }
     }
 
-    // printf( "x %f y %f = { A %f B %f }\n", gloss, NdotV, A / ENVBRDF_SAMPLE_SIZE, B / ENVBRDF_SAMPLE_SIZE );
-    return vec2( A, B ) / float( ENVBRDF_SAMPLE_SIZE );
+    // printf( "x %f y %f = { A %f B %f }\n", gloss, NdotV, A.value() / numSamples, B.value() / numSamples );
+    baker_countSamples( numSamples );
+    BAKER_TRACE_COUNT( s_rejectedSamples, rejected );
+    return vec2( A.value(), B.value() ) / float( numSamples );
+}
+
+typedef vec2 ( *GgxIntegrator )( float alpha, float NdotV, int numSamples, uint32_t scramble );
+
+struct GgxIntegrators
+{
+    int numSamples;
+    GgxIntegrator kernels[2][2]; // [multiscatter][scrambled]
+};
+
+#define GGX_INTEGRATORS( n, Sum ) { n, { \
+    { ggx_IntegrateBRDFKernel< n, false, false, Sum >, ggx_IntegrateBRDFKernel< n, false, true, Sum > }, \
+    { ggx_IntegrateBRDFKernel< n, true, false, Sum >,  ggx_IntegrateBRDFKernel< n, true, true, Sum > } } }
+
+// Counts the tables and error estimates bake at. Anything else runs on the generic kernels, first.
+static const GgxIntegrators s_ggxIntegrators[] = {
+    GGX_INTEGRATORS( 0, BakerSum< float > ),
+    GGX_INTEGRATORS( 64, BakerSum< float > ),
+    GGX_INTEGRATORS( 256, BakerSum< float > ),
+    GGX_INTEGRATORS( ENVBRDF_SAMPLE_SIZE, BakerSum< float > ),
+    GGX_INTEGRATORS( 4096, BakerSum< float > ),
+    GGX_INTEGRATORS( 16384, BakerSum< float > ),
+};
+
+// Reference bakes only need to be exact, not fast.
+static const GgxIntegrators s_ggxReferenceIntegrators = GGX_INTEGRATORS( 0, BakerDoubleSum< float > );
+
+vec2 ggx_IntegrateBRDF( float alpha, float NdotV, bool multiscatter, int numSamples, uint32_t scramble )
+{
+    const GgxIntegrators* integrators = &s_ggxIntegrators[0];
+    if ( baker_referenceSums() ) {
+        integrators = &s_ggxReferenceIntegrators;
+    } else {
+        for( auto& entry : s_ggxIntegrators ) {
+            if ( entry.numSamples == numSamples ) {
+                integrators = &entry;
+                break;
+            }
+        }
+    }
+    return integrators->kernels[multiscatter][scramble != 0]( alpha, NdotV, numSamples, scramble );
 }
 
-vec4 ggx_IntegrateBRDF_Function( float x, float y )
+vec4 ggx_IntegrateBRDF_Function( float x, float y, bool multiscatter, int numSamples, uint32_t scramble )
 {
     float NdotV = max( y, EPS );
     float alpha = x;
-    auto v = ggx_IntegrateBRDF( alpha, NdotV );
+    auto v = ggx_IntegrateBRDF( alpha, NdotV, multiscatter, numSamples, scramble );
     return vec4( v.x, v.y, 0.0f, 1.0f );
 }
 
@@ -151,7 +193,9 @@ vec4 ggx_EvalGitEnvBRDF( float gloss, float NdotV )
     return clamp( vec4( z1, z2, 0.0f, 1.0f ), vec4( 0 ), vec4( 1 ) );
 }
 
-void bake_envBRDF()
+// The three tables are independent jobs.
+//
+void bake_envBRDF( BakeGraph& graph )
 {
 #if TEST_HAMMERSLEY
     for( int i = 0; i < 64; i++ )
@@ -161,11 +205,15 @@ void bake_envBRDF()
     }
 #endif // #if TEST_HAMMERSLEY
 
-    MULTISCATTER_ENVBRDF = false;
-    baker_imageFunction2D( ggx_IntegrateBRDF_Function, 256, "output/env_brdf.png" );
+    baker_addJob( graph, "env_brdf", []() {
+        baker_imageFunction2D( []( float x, float y ) { return ggx_IntegrateBRDF_Function( x, y, false ); }, 256, "output/env_brdf.png" );
+    } );
 
-    MULTISCATTER_ENVBRDF = true;
-    baker_imageFunction2D( ggx_IntegrateBRDF_Function, 256, "output/env_brdf_multiscatter.png" );
+    baker_addJob( graph, "env_brdf_multiscatter", []() {
+        baker_imageFunction2D( []( float x, float y ) { return ggx_IntegrateBRDF_Function( x, y, true ); }, 256, "output/env_brdf_multiscatter.png" );
+    } );
 
-    baker_imageFunction2D( ggx_EvalGitEnvBRDF, 256, "output/env_brdf_fit.png" );
+    baker_addJob( graph, "env_brdf_fit", []() {
+        baker_imageFunction2D( ggx_EvalGitEnvBRDF, 256, "output/env_brdf_fit.png" );
+    } );
 }
\ No newline at end of file
@@ -20,9 +20,17 @@
 #pragma once
 #include "common.h"
 
+#define ENVBRDF_SAMPLE_SIZE 1024
+
 glm::vec2 noise_getHammersleyAtIdx( int idx, int N );
+// Owen scrambled by a per-scramble seed, for randomized QMC error estimates. 0 leaves the points unscrambled.
+glm::vec2 noise_getHammersleyAtIdx( int idx, int N, uint32_t scramble );
 float ggx_GlossToAlpha2( float gloss );
 glm::vec3 ggx_ImportanceSampleGGX( glm::vec2 xi, float alpha2, glm::vec3 N );
 float ggx_SmithGeom( float NdotL, float NdotV, float alpha2 );
+// Counts of 64, 256, 1024, 4096 and 16384 run on kernels compiled for them, other counts on a slower generic one.
+glm::vec2 ggx_IntegrateBRDF( float alpha, float NdotV, bool multiscatter, int numSamples = ENVBRDF_SAMPLE_SIZE, uint32_t scramble = 0 );
+glm::vec4 ggx_IntegrateBRDF_Function( float x, float y, bool multiscatter, int numSamples = ENVBRDF_SAMPLE_SIZE, uint32_t scramble = 0 );
+glm::vec4 ggx_EvalGitEnvBRDF( float gloss, float NdotV );
 
-void bake_envBRDF();
\ No newline at end of file
+void bake_envBRDF( BakeGraph& graph );
\ No newline at end of file
@@ -0,0 +1,824 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "optim.h"
+#include "fit.h"
+
+#include <fstream>
+#include <csv-parser/parser.hpp>
+#include <stb/stb_image.h>
+
+// Tables are regular grids, so the objective works on per-axis power tables instead of a dense basis matrix.
+//
+struct FitProblem
+{
+    int resX, resY;
+    int degreeX, degreeY;
+    std::vector< double > xPow; // xPow[a * resX + i] = x_i^a
+    std::vector< double > yPow; // yPow[b * resY + j] = y_j^b
+    std::vector< double > target;
+    bool rational;
+};
+
+bool fit_ParseForm( std::string name, FitForm& form )
+{
+    if ( name == "polynomial" ) {
+        form = FIT_FORM_POLYNOMIAL;
+    } else if ( name == "rational" ) {
+        form = FIT_FORM_RATIONAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool fit_ParseSolver( std::string name, FitSolver& solver )
+{
+    if ( name == "none" ) {
+        solver = FIT_SOLVER_NONE;
+    } else if ( name == "nm" ) {
+        solver = FIT_SOLVER_NM;
+    } else if ( name == "de" ) {
+        solver = FIT_SOLVER_DE;
+    } else if ( name == "pso" ) {
+        solver = FIT_SOLVER_PSO;
+    } else if ( name == "lbfgs" ) {
+        solver = FIT_SOLVER_LBFGS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static double fit_Coord( int i, int res )
+{
+    return res > 1 ? double( i ) / double( res - 1 ) : 0.0;
+}
+
+static double fit_TableX( const FitTable& table, int i )
+{
+    return table.xMin + ( table.xMax - table.xMin ) * fit_Coord( i, table.resX );
+}
+
+static int fit_NumTerms( const FitSettings& settings )
+{
+    return ( settings.degreeX + 1 ) * ( settings.degreeY + 1 );
+}
+
+// One row per table sample, one column per x^a y^b term.
+//
+arma::mat fit_BasisMatrix( const FitTable& table, const FitSettings& settings )
+{
+    arma::mat basis( table.resX * table.resY, fit_NumTerms( settings ) );
+    for( int i = 0; i < table.resX; i++ ) {
+        for( int j = 0; j < table.resY; j++ ) {
+            int row = i * table.resY + j;
+            double x = fit_TableX( table, i ), y = fit_Coord( j, table.resY );
+            double xa = 1.0;
+            for( int a = 0; a <= settings.degreeX; a++ ) {
+                double yb = 1.0;
+                for( int b = 0; b <= settings.degreeY; b++ ) {
+                    basis( row, a * ( settings.degreeY + 1 ) + b ) = xa * yb;
+                    yb *= y;
+                }
+                xa *= x;
+            }
+        }
+    }
+    return basis;
+}
+
+// Householder QR least squares. Armadillo's solve() needs LAPACK, which we don't link.
+//
+arma::vec fit_SolveLeastSquares( arma::mat A, arma::vec b )
+{
+    int n = int( A.n_rows ), m = int( A.n_cols );
+    std::vector< double > v( n );
+
+    for( int k = 0; k < m; k++ ) {
+        double* colK = A.colptr( k );
+        double norm = 0.0;
+        for( int i = k; i < n; i++ ) norm += colK[i] * colK[i];
+        norm = sqrt( norm );
+        if ( norm == 0.0 ) continue;
+
+        double alpha = colK[k] > 0.0 ? -norm : norm;
+        double vnorm = 0.0;
+        for( int i = k; i < n; i++ ) {
+            v[i] = colK[i] - ( i == k ? alpha : 0.0 );
+            vnorm += v[i] * v[i];
+        }
+        vnorm = sqrt( vnorm );
+        if ( vnorm == 0.0 ) continue;
+        for( int i = k; i < n; i++ ) v[i] /= vnorm;
+
+        auto reflect = [&]( double* col ) {
+            double d = 0.0;
+            for( int i = k; i < n; i++ ) d += v[i] * col[i];
+            for( int i = k; i < n; i++ ) col[i] -= 2.0 * d * v[i];
+        };
+        for( int j = k; j < m; j++ ) {
+            reflect( A.colptr( j ) );
+        }
+        reflect( b.memptr() );
+    }
+
+    // Back substitute, dropping terms the data can't constrain.
+    arma::vec x( m, arma::fill::zeros );
+    for( int k = m - 1; k >= 0; k-- ) {
+        double s = b( k );
+        for( int j = k + 1; j < m; j++ ) s -= A( k, j ) * x( j );
+        x( k ) = std::abs( A( k, k ) ) > 1e-12 ? s / A( k, k ) : 0.0;
+    }
+    return x;
+}
+
+// Evaluates the tensor-product polynomial c over the whole grid. Each x^a row is first collapsed over y
+// ( resY values per power of x ), leaving a Horner step in x per sample that vectorizes along the rows.
+//
+static void fit_EvalGrid( const FitProblem& problem, const double* c, std::vector< double >& out )
+{
+    int dx = problem.degreeX, dy = problem.degreeY, resX = problem.resX, resY = problem.resY;
+    thread_local std::vector< double > g;
+    g.assign( ( dx + 1 ) * resY, 0.0 );
+    for( int a = 0; a <= dx; a++ ) {
+        double* ga = &g[a * resY];
+        for( int b = 0; b <= dy; b++ ) {
+            const double* yb = &problem.yPow[b * resY];
+            double cab = c[a * ( dy + 1 ) + b];
+            for( int j = 0; j < resY; j++ ) ga[j] += cab * yb[j];
+        }
+    }
+
+    out.resize( resX * resY );
+    for( int i = 0; i < resX; i++ ) {
+        double x = problem.xPow[resX + i];
+        double* row = &out[i * resY];
+        const double* gTop = &g[dx * resY];
+        for( int j = 0; j < resY; j++ ) row[j] = gTop[j];
+        for( int a = dx - 1; a >= 0; a-- ) {
+            const double* ga = &g[a * resY];
+            for( int j = 0; j < resY; j++ ) row[j] = row[j] * x + ga[j];
+        }
+    }
+}
+
+// Transpose of fit_EvalGrid: grad[a, b] = scale * sum( w_ij x_i^a y_j^b ).
+//
+static void fit_GradGrid( const FitProblem& problem, const std::vector< double >& w, double scale, double* grad )
+{
+    int dx = problem.degreeX, dy = problem.degreeY, resX = problem.resX, resY = problem.resY;
+    thread_local std::vector< double > moments;
+    moments.resize( ( dy + 1 ) * resX );
+    for( int i = 0; i < resX; i++ ) {
+        const double* row = &w[i * resY];
+        for( int b = 0; b <= dy; b++ ) {
+            const double* yb = &problem.yPow[b * resY];
+            double d = 0.0;
+            for( int j = 0; j < resY; j++ ) d += row[j] * yb[j];
+            moments[b * resX + i] = d;
+        }
+    }
+    for( int a = 0; a <= dx; a++ ) {
+        const double* xa = &problem.xPow[a * resX];
+        for( int b = 0; b <= dy; b++ ) {
+            const double* mb = &moments[b * resX];
+            double d = 0.0;
+            for( int i = 0; i < resX; i++ ) d += xa[i] * mb[i];
+            grad[a * ( dy + 1 ) + b] = scale * d;
+        }
+    }
+}
+
+// Mean squared error over the whole sample grid, with analytic gradient for L-BFGS.
+//
+double fit_Objective( const arma::vec& params, arma::vec* grad, void* data )
+{
+    const FitProblem& problem = *reinterpret_cast< const FitProblem* >( data );
+    int m = ( problem.degreeX + 1 ) * ( problem.degreeY + 1 );
+    int n = int( problem.target.size() );
+    const double* f = problem.target.data();
+
+    // Scratch is reused across calls; solvers call this tens of thousands of times and fresh
+    // table-sized allocations end up costing as much as the evaluation itself.
+    thread_local std::vector< double > P, Q, r;
+    fit_EvalGrid( problem, params.memptr(), P );
+    Q.assign( n, 1.0 );
+    if ( problem.rational ) {
+        std::vector< double > q( m, 1.0 );
+        std::copy( params.begin() + m, params.end(), q.begin() + 1 );
+        fit_EvalGrid( problem, q.data(), Q );
+
+        // Keep the denominator away from zero over the table, a pole anywhere ruins the fit.
+        if ( *std::min_element( Q.begin(), Q.end() ) < 1e-3 ) {
+            if ( grad ) {
+                grad->zeros( params.n_elem );
+            }
+            return 1e10;
+        }
+    }
+
+    r.resize( n );
+    double sumSq = 0.0;
+    for( int i = 0; i < n; i++ ) {
+        P[i] /= Q[i];
+        r[i] = P[i] - f[i];
+        sumSq += r[i] * r[i];
+    }
+
+    if ( grad ) {
+        // dE/dp = 2/n sum( r / Q * b ), dE/dq = -2/n sum( r / Q * R * b ), with R = P / Q.
+        grad->set_size( params.n_elem );
+        for( int i = 0; i < n; i++ ) r[i] /= Q[i];
+        fit_GradGrid( problem, r, 2.0 / n, grad->memptr() );
+        if ( problem.rational ) {
+            std::vector< double > gradQ( m );
+            for( int i = 0; i < n; i++ ) r[i] *= P[i];
+            fit_GradGrid( problem, r, -2.0 / n, gradQ.data() );
+            std::copy( gradQ.begin() + 1, gradQ.end(), grad->begin() + m );
+        }
+    }
+    return sumSq / n;
+}
+
+static arma::vec fit_InitialBounds( const arma::vec& params, double sign )
+{
+    return params + sign * ( arma::abs( params ) * 0.1 + 0.01 );
+}
+
+void fit_RunSolver( arma::vec& params, FitProblem& problem, FitSolver solver )
+{
+    optim::algo_settings_t settings;
+    switch ( solver ) {
+    case FIT_SOLVER_NM:
+        optim::nm( params, fit_Objective, &problem, settings );
+        break;
+    case FIT_SOLVER_DE:
+        settings.de_n_pop = std::max( 40, 10 * int( params.n_elem ) );
+        settings.de_n_gen = 200;
+        settings.de_initial_lb = fit_InitialBounds( params, -1.0 );
+        settings.de_initial_ub = fit_InitialBounds( params, 1.0 );
+        optim::de( params, fit_Objective, &problem, settings );
+        break;
+    case FIT_SOLVER_PSO:
+        settings.pso_n_pop = std::max( 40, 10 * int( params.n_elem ) );
+        settings.pso_n_gen = 200;
+        settings.pso_initial_lb = fit_InitialBounds( params, -1.0 );
+        settings.pso_initial_ub = fit_InitialBounds( params, 1.0 );
+        optim::pso( params, fit_Objective, &problem, settings );
+        break;
+    case FIT_SOLVER_LBFGS:
+        optim::lbfgs( params, fit_Objective, &problem, settings );
+        break;
+    default:
+        break;
+    }
+}
+
+// Multi-start driver. Start 0 refines the least squares fit as-is, the others from jittered copies of it,
+// all in parallel with deterministic per-start seeds. Solvers can wander off or report failure after
+// improving, so the best objective across all starts and the initial guess wins.
+//
+void fit_Refine( arma::vec& params, FitProblem& problem, FitSolver solver, int numStarts )
+{
+    if ( solver == FIT_SOLVER_NONE ) {
+        return;
+    }
+
+    numStarts = std::max( numStarts, 1 );
+    std::vector< arma::vec > starts( numStarts, params );
+    std::vector< double > objective( numStarts, std::numeric_limits< double >::infinity() );
+
+    baker_parallelFor( numStarts, [&]( int s ) {
+        arma::arma_rng::set_seed( 0x9E3779B9u + s );
+        arma::vec& x = starts[s];
+        for( int attempt = 0; s > 0 && attempt < 16; attempt++ ) {
+            x = params + ( arma::abs( params ) * 0.25 + 0.05 ) % arma::randn< arma::vec >( params.n_elem );
+            if ( fit_Objective( x, nullptr, &problem ) < 1e10 ) break;
+        }
+
+        fit_RunSolver( x, problem, solver );
+        if ( x.is_finite() ) {
+            objective[s] = fit_Objective( x, nullptr, &problem );
+        }
+    } );
+
+    int best = int( std::min_element( objective.begin(), objective.end() ) - objective.begin() );
+    if ( objective[best] < fit_Objective( params, nullptr, &problem ) ) {
+        params = starts[best];
+    }
+}
+
+FitPiece fit_TablePiece( const FitTable& table, const FitSettings& settings )
+{
+    FitProblem problem;
+    problem.resX = table.resX;
+    problem.resY = table.resY;
+    problem.degreeX = settings.degreeX;
+    problem.degreeY = settings.degreeY;
+    problem.xPow.resize( ( settings.degreeX + 1 ) * table.resX );
+    problem.yPow.resize( ( settings.degreeY + 1 ) * table.resY );
+    for( int i = 0; i < table.resX; i++ ) {
+        for( int a = 0; a <= settings.degreeX; a++ ) problem.xPow[a * table.resX + i] = pow( fit_TableX( table, i ), a );
+    }
+    for( int j = 0; j < table.resY; j++ ) {
+        for( int b = 0; b <= settings.degreeY; b++ ) problem.yPow[b * table.resY + j] = pow( fit_Coord( j, table.resY ), b );
+    }
+    problem.target.assign( table.values.begin(), table.values.end() );
+    problem.rational = settings.form == FIT_FORM_RATIONAL;
+    int m = fit_NumTerms( settings );
+
+    // Linear least squares start. For rationals, linearize f * Q = P into P - f * ( Q - 1 ) = f.
+    // The linearized rational can land a pole inside the table, so fall back to the polynomial with Q = 1.
+    arma::mat basis = fit_BasisMatrix( table, settings );
+    arma::vec target = arma::conv_to< arma::vec >::from( table.values );
+    arma::vec params = fit_SolveLeastSquares( basis, target );
+    if ( problem.rational ) {
+        arma::mat fQ = basis.cols( 1, m - 1 );
+        fQ.each_col() %= -target;
+        arma::vec linearized = fit_SolveLeastSquares( arma::join_rows( basis, fQ ), target );
+        params = arma::join_cols( params, arma::vec( m - 1, arma::fill::zeros ) );
+        if ( fit_Objective( linearized, nullptr, &problem ) < fit_Objective( params, nullptr, &problem ) ) {
+            params = linearized;
+        }
+    }
+
+    // Polynomial least squares is already the L2 optimum.
+    if ( problem.rational ) {
+        fit_Refine( params, problem, settings.solver, settings.numStarts );
+    }
+
+    FitPiece piece;
+    piece.xMax = table.xMax;
+    piece.numerator.assign( params.begin(), params.begin() + m );
+    piece.denominator.assign( params.begin() + m, params.end() );
+    return piece;
+}
+
+FitResult fit_Table( const FitTable& table, FitSettings settings )
+{
+    // Pieces split the rows evenly and share their boundary row.
+    settings.numPieces = std::max( 1, std::min( settings.numPieces, ( table.resX - 1 ) / 2 ) );
+    std::vector< int > rowSplit( settings.numPieces + 1 );
+    for( int k = 0; k <= settings.numPieces; k++ ) {
+        rowSplit[k] = ( k * ( table.resX - 1 ) + settings.numPieces / 2 ) / settings.numPieces;
+    }
+
+    // Degrees beyond what the grid can resolve only make the system singular.
+    settings.degreeX = std::min( settings.degreeX, ( table.resX - 1 ) / settings.numPieces );
+    settings.degreeY = std::min( settings.degreeY, table.resY - 1 );
+    if ( fit_NumTerms( settings ) < 2 ) {
+        settings.form = FIT_FORM_POLYNOMIAL;
+    }
+
+    FitResult fit;
+    fit.settings = settings;
+    fit.xMin = table.xMin;
+    fit.xMax = table.xMax;
+    fit.hasY = table.resY > 1;
+    for( int k = 0; k < settings.numPieces; k++ ) {
+        FitTable piece;
+        piece.resX = rowSplit[k + 1] - rowSplit[k] + 1;
+        piece.resY = table.resY;
+        piece.xMin = fit_Coord( rowSplit[k], table.resX );
+        piece.xMax = fit_Coord( rowSplit[k + 1], table.resX );
+        piece.values.assign( table.values.begin() + rowSplit[k] * table.resY, table.values.begin() + ( rowSplit[k + 1] + 1 ) * table.resY );
+        fit.pieces.push_back( fit_TablePiece( piece, settings ) );
+    }
+
+    double sumSq = 0.0;
+    for( int i = 0; i < table.resX; i++ ) {
+        for( int j = 0; j < table.resY; j++ ) {
+            double err = std::abs( fit_Eval( fit, fit_TableX( table, i ), fit_Coord( j, table.resY ) ) - table.values[i * table.resY + j] );
+            fit.maxError = std::max( fit.maxError, err );
+            sumSq += err * err;
+        }
+    }
+    fit.rmsError = sqrt( sumSq / double( table.values.size() ) );
+    return fit;
+}
+
+static double fit_EvalTerms( const std::vector< double >& c, int degreeX, int degreeY, double x, double y )
+{
+    double sum = 0.0, xa = 1.0;
+    for( int a = 0; a <= degreeX; a++ ) {
+        double yb = 1.0;
+        for( int b = 0; b <= degreeY; b++ ) {
+            sum += c[a * ( degreeY + 1 ) + b] * xa * yb;
+            yb *= y;
+        }
+        xa *= x;
+    }
+    return sum;
+}
+
+double fit_Eval( const FitResult& fit, double x, double y )
+{
+    x = ( x - fit.xMin ) / ( fit.xMax - fit.xMin );
+    size_t k = 0;
+    while ( k + 1 < fit.pieces.size() && x > fit.pieces[k].xMax ) k++;
+    const FitPiece& piece = fit.pieces[k];
+
+    double p = fit_EvalTerms( piece.numerator, fit.settings.degreeX, fit.settings.degreeY, x, y );
+    if ( fit.settings.form != FIT_FORM_RATIONAL ) {
+        return p;
+    }
+    std::vector< double > q( 1, 1.0 );
+    q.insert( q.end(), piece.denominator.begin(), piece.denominator.end() );
+    return p / fit_EvalTerms( q, fit.settings.degreeX, fit.settings.degreeY, x, y );
+}
+
+// Rough shader ALU cost of the emitted code, in full-rate instructions. Every Horner step is one MAD,
+// the rational divide is counted as 4 ( quarter-rate reciprocal + multiply ), every piece boundary
+// as a compare and a branch, assuming the branch is coherent so only one piece runs, and mapping x
+// from a domain other than [0, 1] as one more MAD.
+//
+static bool fit_UnitDomain( const FitResult& fit )
+{
+    return fit.xMin == 0.0 && fit.xMax == 1.0;
+}
+
+int fit_EstimateCost( const FitResult& fit )
+{
+    const FitSettings& settings = fit.settings;
+    int cost = settings.degreeY == 0 ? settings.degreeX : ( settings.degreeX + 1 ) * settings.degreeY + settings.degreeX;
+    if ( settings.form == FIT_FORM_RATIONAL ) {
+        cost = cost * 2 + 4;
+    }
+    return cost + 2 * ( int( fit.pieces.size() ) - 1 ) + ( fit_UnitDomain( fit ) ? 0 : 1 );
+}
+
+static std::string fit_Literal( double v, FitLanguage lang )
+{
+    char buf[64];
+    snprintf( buf, sizeof( buf ), "%.9g", std::abs( v ) );
+    std::string s = buf;
+    if ( s.find_first_of( ".e" ) == std::string::npos ) {
+        s += ".0";
+    }
+    if ( lang != FIT_LANGUAGE_GLSL ) {
+        s += "f";
+    }
+    return s;
+}
+
+// Horner's scheme, one multiply-add per line: v = v * t + c.
+//
+static void fit_EmitHorner( std::string& code, std::string indent, std::string var, const double* c, int stride, int degree, std::string t, FitLanguage lang )
+{
+    code += indent + "float " + var + " = " + ( c[degree * stride] < 0.0 ? "-" : "" ) + fit_Literal( c[degree * stride], lang ) + ";\n";
+    for( int k = degree - 1; k >= 0; k-- ) {
+        code += indent + var + " = " + var + " * " + t + ( c[k * stride] < 0.0 ? " - " : " + " ) + fit_Literal( c[k * stride], lang ) + ";\n";
+    }
+}
+
+static void fit_EmitPolynomial( std::string& code, std::string indent, std::string var, const std::vector< double >& c, const FitSettings& settings, FitLanguage lang )
+{
+    int stride = settings.degreeY + 1;
+    if ( settings.degreeY == 0 ) {
+        fit_EmitHorner( code, indent, var, c.data(), 1, settings.degreeX, "x", lang );
+        return;
+    }
+
+    // Collapse y first into one coefficient per power of x, then Horner over x.
+    for( int a = settings.degreeX; a >= 0; a-- ) {
+        fit_EmitHorner( code, indent, var + std::to_string( a ), c.data() + a * stride, 1, settings.degreeY, "y", lang );
+    }
+    code += indent + "float " + var + " = " + var + std::to_string( settings.degreeX ) + ";\n";
+    for( int a = settings.degreeX - 1; a >= 0; a-- ) {
+        code += indent + var + " = " + var + " * x + " + var + std::to_string( a ) + ";\n";
+    }
+}
+
+static void fit_EmitPiece( std::string& code, std::string indent, const FitPiece& piece, const FitSettings& settings, FitLanguage lang )
+{
+    fit_EmitPolynomial( code, indent, "p", piece.numerator, settings, lang );
+    if ( settings.form == FIT_FORM_RATIONAL ) {
+        std::vector< double > q( 1, 1.0 );
+        q.insert( q.end(), piece.denominator.begin(), piece.denominator.end() );
+        fit_EmitPolynomial( code, indent, "q", q, settings, lang );
+        code += indent + "return p / q;\n";
+    } else {
+        code += indent + "return p;\n";
+    }
+}
+
+std::string fit_EmitCode( const FitResult& fit, std::string functionName, std::string comment, FitLanguage lang )
+{
+    const FitSettings& settings = fit.settings;
+    char header[256];
+    snprintf( header, sizeof( header ), "// %s: %s, degree %d x %d, %d piece(s). Max error %g, RMS error %g, ~%d ALU.\n",
+        comment.c_str(), settings.form == FIT_FORM_RATIONAL ? "rational" : "polynomial",
+        settings.degreeX, settings.degreeY, int( fit.pieces.size() ), fit.maxError, fit.rmsError, fit_EstimateCost( fit ) );
+
+    std::string code = header;
+    code += lang == FIT_LANGUAGE_CPP ? "inline float " : "float ";
+    if ( !fit.hasY ) {
+        code += functionName + "( float x )\n{\n";
+    } else if ( settings.degreeY == 0 && lang == FIT_LANGUAGE_CPP ) {
+        code += functionName + "( float x, float /*y*/ )\n{\n";
+    } else {
+        code += functionName + "( float x, float y )\n{\n";
+    }
+    if ( !fit_UnitDomain( fit ) ) {
+        double scale = 1.0 / ( fit.xMax - fit.xMin );
+        double offset = -fit.xMin * scale;
+        char domain[64];
+        snprintf( domain, sizeof( domain ), "; // [ %g, %g ] to [ 0, 1 ]\n", fit.xMin, fit.xMax );
+        code += "    x = x * " + fit_Literal( scale, lang ) + ( offset < 0.0 ? " - " : " + " ) + fit_Literal( offset, lang ) + domain;
+    }
+
+    for( size_t k = 0; k + 1 < fit.pieces.size(); k++ ) {
+        code += "    if ( x <= " + fit_Literal( fit.pieces[k].xMax, lang ) + " ) {\n";
+        fit_EmitPiece( code, "        ", fit.pieces[k], settings, lang );
+        code += "    }\n";
+    }
+    fit_EmitPiece( code, "    ", fit.pieces.back(), settings, lang );
+    code += "}\n\n";
+    return code;
+}
+
+// Fits sample the table on a regular grid, so CSV rows set the x range from their first and last coordinates,
+// and rows spaced unevenly are resampled linearly onto as many evenly spaced ones. Coordinates must increase.
+//
+static bool fit_RegularizeRows( std::string fileName, const std::vector< double >& coords, std::vector< FitTable >& channels )
+{
+    int numRows = int( coords.size() );
+    for( int i = 1; i < numRows; i++ ) {
+        if ( !( coords[i] > coords[i - 1] ) ) {
+            printf( "    Coordinates of %s must increase, %g follows %g.\n", fileName.c_str(), coords[i], coords[i - 1] );
+            return false;
+        }
+    }
+
+    double xMin = coords.front(), xMax = coords.back();
+    double step = ( xMax - xMin ) / ( numRows - 1 );
+    bool regular = true;
+    for( int i = 0; i < numRows; i++ ) {
+        regular = regular && std::abs( coords[i] - ( xMin + i * step ) ) <= 1e-3 * step;
+    }
+    for( auto& table : channels ) {
+        table.xMin = xMin;
+        table.xMax = xMax;
+    }
+    if ( regular ) {
+        return true;
+    }
+
+    printf( "    %s is spaced unevenly, resampling %d rows.\n", fileName.c_str(), numRows );
+    for( auto& table : channels ) {
+        std::vector< float > resampled( numRows );
+        int k = 0;
+        for( int i = 0; i < numRows; i++ ) {
+            double x = i == numRows - 1 ? xMax : xMin + i * step;
+            while ( k + 2 < numRows && coords[k + 1] < x ) k++;
+            double t = std::max( 0.0, std::min( 1.0, ( x - coords[k] ) / ( coords[k + 1] - coords[k] ) ) );
+            resampled[i] = float( table.values[k] + ( table.values[k + 1] - table.values[k] ) * t );
+        }
+        table.values = resampled;
+    }
+    return true;
+}
+
+// CSV tables are 1D: first column is the coordinate, every following column is a channel.
+// Images are 2D with rows along x, matching baker_imageFunction2D, over [0, 1]; alpha is ignored.
+//
+bool fit_LoadTable( std::string fileName, std::vector< FitTable >& channels )
+{
+    namespace fs = std::experimental::filesystem;
+    channels.clear();
+
+    if ( fs::path( fileName ).extension().u8string() == ".csv" ) {
+        std::ifstream f( fileName );
+        if ( !f.is_open() ) {
+            return false;
+        }
+        aria::csv::CsvParser parser( f );
+        std::vector< double > coords;
+        for( auto& row : parser ) {
+            double coord;
+            std::vector< float > values;
+            try {
+                if ( row.empty() ) continue;
+                coord = std::stod( row[0] );
+                for( size_t c = 1; c < row.size(); c++ ) {
+                    values.push_back( std::stof( row[c] ) );
+                }
+            } catch ( ... ) {
+                continue;
+            }
+            if ( channels.empty() ) {
+                channels.resize( values.size() );
+                for( size_t c = 0; c < channels.size(); c++ ) {
+                    channels[c].name = std::to_string( c + 1 );
+                }
+            }
+            if ( channels.empty() || values.size() < channels.size() ) continue;
+            coords.push_back( coord );
+            for( size_t c = 0; c < channels.size(); c++ ) {
+                channels[c].values.push_back( values[c] );
+                channels[c].resX++;
+            }
+        }
+        return !channels.empty() && channels[0].resX > 1 && fit_RegularizeRows( fileName, coords, channels );
+    }
+
+    int w, h, comp;
+    bool hdr = stbi_is_hdr( fileName.c_str() ) != 0;
+    float* dataf = hdr ? stbi_loadf( fileName.c_str(), &w, &h, &comp, 0 ) : nullptr;
+    unsigned char* data = hdr ? nullptr : stbi_load( fileName.c_str(), &w, &h, &comp, 0 );
+    if ( !dataf && !data ) {
+        return false;
+    }
+
+    int numChannels = ( comp == 2 || comp == 4 ) ? comp - 1 : comp;
+    channels.resize( numChannels );
+    for( int c = 0; c < numChannels; c++ ) {
+        channels[c].name = std::string( 1, "rgb"[c] );
+        channels[c].resX = h;
+        channels[c].resY = w;
+        channels[c].values.resize( w * h );
+        for( int i = 0; i < w * h; i++ ) {
+            channels[c].values[i] = hdr ? dataf[i * comp + c] : data[i * comp + c] / 255.0f;
+        }
+    }
+    stbi_image_free( hdr ? ( void* ) dataf : ( void* ) data );
+    return true;
+}
+
+void bake_fitTable( std::string fileName, FitSettings settings )
+{
+    namespace fs = std::experimental::filesystem;
+    std::string stem = fs::path( fileName ).stem().u8string();
+    for( auto& ch : stem ) {
+        if ( !isalnum( ( unsigned char ) ch ) ) ch = '_';
+    }
+
+    printf( "Fitting %s ...\n", fileName.c_str() );
+    std::vector< FitTable > channels;
+    if ( !fit_LoadTable( fileName, channels ) ) {
+        printf( "    Failed to load table %s.\n\n", fileName.c_str() );
+        return;
+    }
+
+    std::string code[3];
+    for( auto& table : channels ) {
+        auto range = std::minmax_element( table.values.begin(), table.values.end() );
+        if ( *range.second - *range.first < EPS ) {
+            printf( "    Channel %s is constant, skipping.\n", table.name.c_str() );
+            continue;
+        }
+
+        auto fit = fit_Table( table, settings );
+        printf( "    Channel %s: max error %f, RMS error %f\n", table.name.c_str(), fit.maxError, fit.rmsError );
+
+        std::string functionName = stem + "_fit_" + table.name;
+        std::string comment = "Fit of " + fileName + " channel " + table.name;
+        for( int lang = 0; lang < 3; lang++ ) {
+            code[lang] += fit_EmitCode( fit, functionName, comment, FitLanguage( lang ) );
+        }
+    }
+
+    const char* extensions[] = { ".cpp", ".hlsl", ".glsl" };
+    for( int lang = 0; lang < 3; lang++ ) {
+        std::string outputFileName = "output/" + stem + "_fit" + extensions[lang];
+        FILE* fp = fopen( outputFileName.c_str(), "w" );
+        fprintf( fp, "%s", code[lang].c_str() );
+        fclose( fp );
+        printf( "    Output to %s OK.\n", outputFileName.c_str() );
+    }
+    printf( "\n" );
+}
+
+static std::string fit_SearchName( const FitResult& fit )
+{
+    const FitSettings& settings = fit.settings;
+    std::string name = ( settings.form == FIT_FORM_RATIONAL ? "rational" : "poly" ) + std::to_string( settings.degreeX ) + "x" + std::to_string( settings.degreeY );
+    if ( fit.pieces.size() > 1 ) {
+        name += "_" + std::to_string( fit.pieces.size() ) + "pieces";
+    }
+    return name;
+}
+
+// Fits every form, degree pair and piece count up to maxSettings in parallel, then keeps the fits that
+// no other fit beats on both estimated ALU cost and max error.
+//
+void bake_fitSearch( std::string fileName, FitSettings maxSettings, double errorBudget )
+{
+    namespace fs = std::experimental::filesystem;
+    std::string stem = fs::path( fileName ).stem().u8string();
+    for( auto& ch : stem ) {
+        if ( !isalnum( ( unsigned char ) ch ) ) ch = '_';
+    }
+
+    printf( "Searching fits for %s ...\n", fileName.c_str() );
+    std::vector< FitTable > channels;
+    if ( !fit_LoadTable( fileName, channels ) ) {
+        printf( "    Failed to load table %s.\n\n", fileName.c_str() );
+        return;
+    }
+
+    std::string csvFileName = "output/" + stem + "_pareto.csv";
+    FILE* csv = fopen( csvFileName.c_str(), "w" );
+    fprintf( csv, "channel,fit,cost,max_error,rms_error,pareto\n" );
+    std::string code[3];
+
+    for( auto& table : channels ) {
+        auto range = std::minmax_element( table.values.begin(), table.values.end() );
+        if ( *range.second - *range.first < EPS ) {
+            printf( "    Channel %s is constant, skipping.\n", table.name.c_str() );
+            continue;
+        }
+
+        std::vector< FitSettings > candidates;
+        for( int form = FIT_FORM_POLYNOMIAL; form <= FIT_FORM_RATIONAL; form++ ) {
+            for( int pieces = 1; pieces <= maxSettings.numPieces; pieces *= 2 ) {
+                for( int dx = 0; dx <= maxSettings.degreeX; dx++ ) {
+                    for( int dy = 0; dy <= std::min( maxSettings.degreeY, table.resY - 1 ); dy++ ) {
+                        if ( form == FIT_FORM_RATIONAL && dx == 0 && dy == 0 ) continue;
+                        FitSettings settings = maxSettings;
+                        settings.form = FitForm( form );
+                        settings.degreeX = dx;
+                        settings.degreeY = dy;
+                        settings.numPieces = pieces;
+                        candidates.push_back( settings );
+                    }
+                }
+            }
+        }
+
+        std::vector< FitResult > fits( candidates.size() );
+        baker_parallelFor( int( candidates.size() ), [&]( int i ) {
+            fits[i] = fit_Table( table, candidates[i] );
+        } );
+
+        std::vector< int > order( fits.size() );
+        for( size_t i = 0; i < order.size(); i++ ) order[i] = int( i );
+        std::sort( order.begin(), order.end(), [&]( int a, int b ) {
+            int costA = fit_EstimateCost( fits[a] ), costB = fit_EstimateCost( fits[b] );
+            return costA != costB ? costA < costB : fits[a].maxError < fits[b].maxError;
+        } );
+
+        printf( "    Channel %s Pareto frontier ( %d candidates ):\n", table.name.c_str(), int( fits.size() ) );
+        printf( "        %6s %12s %12s  %s\n", "cost", "max error", "rms error", "fit" );
+        std::vector< char > pareto( fits.size(), 0 );
+        double bestError = std::numeric_limits< double >::infinity();
+        int cheapestInBudget = -1;
+        for( int i : order ) {
+            if ( fits[i].maxError >= bestError ) continue;
+            bestError = fits[i].maxError;
+            pareto[i] = 1;
+            printf( "        %6d %12f %12f  %s\n", fit_EstimateCost( fits[i] ), fits[i].maxError, fits[i].rmsError, fit_SearchName( fits[i] ).c_str() );
+            if ( cheapestInBudget < 0 && fits[i].maxError <= errorBudget ) {
+                cheapestInBudget = i;
+            }
+
+            std::string functionName = stem + "_fit_" + table.name + "_" + fit_SearchName( fits[i] );
+            std::string comment = "Fit of " + fileName + " channel " + table.name;
+            for( int lang = 0; lang < 3; lang++ ) {
+                code[lang] += fit_EmitCode( fits[i], functionName, comment, FitLanguage( lang ) );
+            }
+        }
+        if ( errorBudget > 0.0 ) {
+            if ( cheapestInBudget >= 0 ) {
+                printf( "    Cheapest within max error %g: %s\n", errorBudget, fit_SearchName( fits[cheapestInBudget] ).c_str() );
+            } else {
+                printf( "    Nothing within max error %g.\n", errorBudget );
+            }
+        }
+
+        for( int i : order ) {
+            fprintf( csv, "%s,%s,%d,%.8f,%.8f,%d\n", table.name.c_str(), fit_SearchName( fits[i] ).c_str(),
+                fit_EstimateCost( fits[i] ), fits[i].maxError, fits[i].rmsError, int( pareto[i] ) );
+        }
+    }
+    fclose( csv );
+    printf( "    Output to %s OK.\n", csvFileName.c_str() );
+
+    const char* extensions[] = { ".cpp", ".hlsl", ".glsl" };
+    for( int lang = 0; lang < 3; lang++ ) {
+        std::string outputFileName = "output/" + stem + "_pareto" + extensions[lang];
+        FILE* fp = fopen( outputFileName.c_str(), "w" );
+        fprintf( fp, "%s", code[lang].c_str() );
+        fclose( fp );
+        printf( "    Output to %s OK.\n", outputFileName.c_str() );
+    }
+    printf( "\n" );
+}
@@ -0,0 +1,103 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+
+enum FitForm
+{
+    FIT_FORM_POLYNOMIAL,
+    FIT_FORM_RATIONAL
+};
+
+enum FitSolver
+{
+    FIT_SOLVER_NONE,
+    FIT_SOLVER_NM,
+    FIT_SOLVER_DE,
+    FIT_SOLVER_PSO,
+    FIT_SOLVER_LBFGS
+};
+
+enum FitLanguage
+{
+    FIT_LANGUAGE_CPP,
+    FIT_LANGUAGE_HLSL,
+    FIT_LANGUAGE_GLSL
+};
+
+struct FitSettings
+{
+    FitForm form = FIT_FORM_POLYNOMIAL;
+    int degreeX = 2;
+    int degreeY = 5;
+    FitSolver solver = FIT_SOLVER_NM;
+    int numStarts = 1; // Independent solver runs, in parallel, for escaping local minima.
+    int numPieces = 1; // Uniform segments along x, each with its own fit.
+};
+
+// Single channel of a baked table on a regular grid over [xMin, xMax] x [0, 1], laid out like
+// baker_imageFunction2D. 1D tables have resY = 1.
+//
+struct FitTable
+{
+    std::string name;
+    int resX = 0;
+    int resY = 1;
+    double xMin = 0.0;
+    double xMax = 1.0;
+    std::vector< float > values;
+};
+
+// Tensor-product polynomial coefficients, index ( a * ( degreeY + 1 ) + b ) holds the x^a y^b term.
+// The denominator of a rational fit has an implicit constant term of 1, which isn't stored.
+// A piece covers mapped x up to xMax; the last piece covers the rest.
+//
+struct FitPiece
+{
+    double xMax = 1.0;
+    std::vector< double > numerator;
+    std::vector< double > denominator;
+};
+
+// Fits are in x mapped from [xMin, xMax] to [0, 1], which keeps the powers of x well conditioned whatever the
+// table's coordinates; piece bounds are in mapped x too. Fits of 2D tables take y even when degreeY is 0.
+//
+struct FitResult
+{
+    FitSettings settings;
+    double xMin = 0.0;
+    double xMax = 1.0;
+    bool hasY = false;
+    std::vector< FitPiece > pieces;
+    double maxError = 0.0;
+    double rmsError = 0.0;
+};
+
+bool fit_ParseForm( std::string name, FitForm& form );
+bool fit_ParseSolver( std::string name, FitSolver& solver );
+
+FitResult fit_Table( const FitTable& table, FitSettings settings );
+double fit_Eval( const FitResult& fit, double x, double y );
+int fit_EstimateCost( const FitResult& fit );
+std::string fit_EmitCode( const FitResult& fit, std::string functionName, std::string comment, FitLanguage lang );
+
+bool fit_LoadTable( std::string fileName, std::vector< FitTable >& channels );
+void bake_fitTable( std::string fileName, FitSettings settings );
+void bake_fitSearch( std::string fileName, FitSettings maxSettings, double errorBudget );
@@ -19,64 +19,113 @@
 
 #include "env_brdf.h"
 #include "gloss_normal.h"
+#include "sampling.h"
 using namespace glm;
 
-#define GLOSSNORMAL_SAMPLE_SIZE 8192
-
 std::vector< float > s_glossToAvgNormalLength;
 
-float glossNormal_IntegrateGlossNormalGGX( float gloss )
+// Instantiated per sample count, scrambling and accumulator like the env BRDF kernels; fixedSamples 0 takes the
+// count at run time.
+//
+template< int fixedSamples, bool scrambled, typename Sum >
+float glossNormal_IntegrateKernel( float gloss, int runtimeSamples, uint32_t scramble )
 {
+    const int numSamples = fixedSamples ? fixedSamples : runtimeSamples;
     vec3 N = vec3( 0, 0, 1 );
     float alpha2 = ggx_GlossToAlpha2( gloss );
-    vec3 averageNormal = vec3( 0.0f );
+    Sum averageNormal;
 
-    for( uint i = 0; i < GLOSSNORMAL_SAMPLE_SIZE; i++ )
+    for( int i = 0; i < numSamples; i++ )
     {
-        auto xi = noise_getHammersleyAtIdx( i, GLOSSNORMAL_SAMPLE_SIZE );
+        auto xi = scrambled ? noise_getHammersleyAtIdx( i, numSamples, scramble ) : sampling_Hammersley2D( i, numSamples );
         auto H = ggx_ImportanceSampleGGX( xi, alpha2, N );
-        averageNormal += H;
+        averageNormal.add( H );
     }
 
-    averageNormal /= GLOSSNORMAL_SAMPLE_SIZE;
-    return length( averageNormal );
+    baker_countSamples( numSamples );
+    return length( averageNormal.value() / float( numSamples ) );
+}
+
+typedef float ( *GlossNormalIntegrator )( float gloss, int numSamples, uint32_t scramble );
+
+struct GlossNormalIntegrators
+{
+    int numSamples;
+    GlossNormalIntegrator kernels[2]; // [scrambled]
+};
+
+#define GLOSSNORMAL_INTEGRATORS( n, Sum ) { n, { glossNormal_IntegrateKernel< n, false, Sum >, glossNormal_IntegrateKernel< n, true, Sum > } }
+
+// Generic kernels first.
+static const GlossNormalIntegrators s_glossNormalIntegrators[] = {
+    GLOSSNORMAL_INTEGRATORS( 0, BakerSum< vec3 > ),
+    GLOSSNORMAL_INTEGRATORS( 64, BakerSum< vec3 > ),
+    GLOSSNORMAL_INTEGRATORS( 256, BakerSum< vec3 > ),
+    GLOSSNORMAL_INTEGRATORS( 1024, BakerSum< vec3 > ),
+    GLOSSNORMAL_INTEGRATORS( 4096, BakerSum< vec3 > ),
+    GLOSSNORMAL_INTEGRATORS( GLOSSNORMAL_SAMPLE_SIZE, BakerSum< vec3 > ),
+};
+
+static const GlossNormalIntegrators s_glossNormalReferenceIntegrators = GLOSSNORMAL_INTEGRATORS( 0, BakerDoubleSum< vec3 > );
+
+float glossNormal_IntegrateGlossNormalGGX( float gloss, int numSamples, uint32_t scramble )
+{
+    const GlossNormalIntegrators* integrators = &s_glossNormalIntegrators[0];
+    if ( baker_referenceSums() ) {
+        integrators = &s_glossNormalReferenceIntegrators;
+    } else {
+        for( auto& entry : s_glossNormalIntegrators ) {
+            if ( entry.numSamples == numSamples ) {
+                integrators = &entry;
+                break;
+            }
+        }
+    }
+    return integrators->kernels[scramble != 0]( gloss, numSamples, scramble );
 }
 
-float glossNormal_NormalLengthToGloss( float normalLength )
+float glossNormal_NormalLengthToGloss( const std::vector< float >& glossToAvgNormalLength, float normalLength )
 {
-    for( int i = 0; i < int( s_glossToAvgNormalLength.size() ) - 1; i++ ) {
-        if ( s_glossToAvgNormalLength[ i + 1 ] > normalLength ) {
+    for( int i = 0; i < int( glossToAvgNormalLength.size() ) - 1; i++ ) {
+        if ( glossToAvgNormalLength[ i + 1 ] > normalLength ) {
             return float( i ) / 255.0f;
         }
     }
     return 1.0f;
 }
 
-vec4 glossNormal_GenerateGlossCombineTable( float glossX, float glossY )
+std::vector< float > glossNormal_IntegrateNormalLengths( int numSamples )
 {
-    // Need to call ggx_IntegrateGlossNormal to build table before calling this!
-    assert( s_glossToAvgNormalLength.size() != 0 );
+    BAKER_TRACE_SCOPE( "integrate gloss normal lengths" );
+    std::vector< float > glossToAvgNormalLength( 256 );
+    for( int i = 0; i < 256; i++ ) {
+        float gloss = float ( i ) / 255.0f;
+        glossToAvgNormalLength[i] = glossNormal_IntegrateGlossNormalGGX( gloss, numSamples );
+    }
+    return glossToAvgNormalLength;
+}
+
+vec4 glossNormal_GenerateGlossCombineTable( const std::vector< float >& glossToAvgNormalLength, float glossX, float glossY )
+{
+    // Need to call glossNormal_IntegrateNormalLengths to build table before calling this!
+    assert( glossToAvgNormalLength.size() != 0 );
 
     auto glossIdxX = int( glossX * 255 );
     auto glossIdxY = int( glossY * 255 );
-    float normalLenX = s_glossToAvgNormalLength[ glossIdxX ];
-    float normalLenY = s_glossToAvgNormalLength[ glossIdxY ];
+    float normalLenX = glossToAvgNormalLength[ glossIdxX ];
+    float normalLenY = glossToAvgNormalLength[ glossIdxY ];
     float normanLenCombined = normalLenX * normalLenY;
 
-    float combinedGloss = glossNormal_NormalLengthToGloss( normanLenCombined );
+    float combinedGloss = glossNormal_NormalLengthToGloss( glossToAvgNormalLength, normanLenCombined );
     return vec4( combinedGloss, combinedGloss, combinedGloss, 1.0f );
 }
 
-void bake_glossNormalTable()
+void glossNormal_BakeNormalLengthTable()
 {
     printf( "Baking gloss to avg normal length to output/gloss_normal_length.cpp...\n" );
-    s_glossToAvgNormalLength.resize( 256 );
 
     // Bake normal lengths numerically.
-    for( int i = 0; i < 256; i++ ) {
-        float gloss = float ( i ) / 255.0f;
-        s_glossToAvgNormalLength[i] = glossNormal_IntegrateGlossNormalGGX( gloss );
-    }
+    s_glossToAvgNormalLength = glossNormal_IntegrateNormalLengths( GLOSSNORMAL_SAMPLE_SIZE );
 
     // Output to file as C code!
     FILE* fp = fopen( "output/gloss_normal_length.cpp", "w" );
@@ -98,7 +147,16 @@ void bake_glossNormalTable()
         fprintf( fp, "%.4f,%.8f\n", gloss, s_glossToAvgNormalLength[i] );
     }
     fclose( fp );
+}
 
-    // Bake combined gloss table.
-    baker_imageFunction2D( glossNormal_GenerateGlossCombineTable, 256, "output/gloss_combine.png" );
+// The gloss combine table looks up the normal length table, so it waits for it.
+//
+void bake_glossNormalTable( BakeGraph& graph )
+{
+    int normalLengthJob = baker_addJob( graph, "gloss_normal_length", glossNormal_BakeNormalLengthTable );
+    baker_addJob( graph, "gloss_combine", []() {
+        baker_imageFunction2D( []( float x, float y ) {
+            return glossNormal_GenerateGlossCombineTable( s_glossToAvgNormalLength, x, y );
+        }, 256, "output/gloss_combine.png" );
+    }, { normalLengthJob } );
 }
\ No newline at end of file
@@ -20,4 +20,14 @@
 #pragma once
 #include "common.h"
 
-void bake_glossNormalTable();
\ No newline at end of file
+#define GLOSSNORMAL_SAMPLE_SIZE 8192
+
+// Average length of GGX sampled normals for one gloss value, Hammersley points scrambled as by
+// noise_getHammersleyAtIdx. Counts of 64, 256, 1024, 4096 and GLOSSNORMAL_SAMPLE_SIZE run on kernels compiled for
+// them, other counts on a slower generic one.
+float glossNormal_IntegrateGlossNormalGGX( float gloss, int numSamples, uint32_t scramble = 0 );
+// Average length of GGX sampled normals for 256 gloss values in [0, 1], which the gloss combine table looks up.
+std::vector< float > glossNormal_IntegrateNormalLengths( int numSamples );
+glm::vec4 glossNormal_GenerateGlossCombineTable( const std::vector< float >& glossToAvgNormalLength, float glossX, float glossY );
+
+void bake_glossNormalTable( BakeGraph& graph );
\ No newline at end of file
@@ -0,0 +1,279 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+using namespace glm;
+
+#include <cassert>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+// A pool of workers shared by every parallel loop and bake job started from its threads. Threads that wait, for
+// a loop to finish or for a graph to drain, run queued tasks in the meantime, so nested loops and jobs that use
+// loops themselves never leave the machine idle or block on each other.
+//
+// The CLI uses the default pool. Embedders create their own with baker_createPool, and bake inside
+// baker_withPool, which also hands every task the cancel flag of the bake it belongs to.
+//
+struct BakerTask
+{
+    std::function< void() > func;
+    BakerCancel* cancel;
+};
+
+struct BakerThreadPool
+{
+    std::mutex mutex;
+    std::condition_variable changed; // New tasks, finished loops and jobs, or shutdown.
+    std::deque< BakerTask > tasks;
+    std::vector< std::thread > threads;
+    int numThreads = 0; // 0 for all hardware threads.
+    bool quit = false;
+};
+
+static BakerThreadPool s_defaultPool;
+static thread_local BakerThreadPool* t_pool = nullptr;
+static thread_local BakerCancel* t_cancel = nullptr;
+
+BakerThreadPool& baker_currentPool()
+{
+    return t_pool ? *t_pool : s_defaultPool;
+}
+
+bool baker_cancelled()
+{
+    if ( !t_cancel || !t_cancel->requested ) return false;
+    t_cancel->seen = true;
+    return true;
+}
+
+void baker_runTask( BakerTask& task )
+{
+    auto cancel = t_cancel;
+    t_cancel = task.cancel;
+    task.func();
+    t_cancel = cancel;
+}
+
+void baker_stopPool( BakerThreadPool& pool )
+{
+    {
+        std::lock_guard< std::mutex > lock( pool.mutex );
+        pool.quit = true;
+    }
+    pool.changed.notify_all();
+    for( auto& t : pool.threads ) {
+        t.join();
+    }
+    pool.threads.clear();
+    pool.quit = false;
+}
+
+int baker_poolThreads( const BakerThreadPool& pool )
+{
+    return pool.numThreads > 0 ? pool.numThreads : std::max( 1, int( std::thread::hardware_concurrency() ) );
+}
+
+// Workers are started on first use; the calling thread always takes part, so there is one less than the thread count.
+void baker_startPool( BakerThreadPool& pool )
+{
+    static std::once_flag s_atExit;
+    std::call_once( s_atExit, []() { std::atexit( []() { baker_stopPool( s_defaultPool ); } ); } );
+
+    std::lock_guard< std::mutex > lock( pool.mutex );
+    while ( int( pool.threads.size() ) < baker_poolThreads( pool ) - 1 ) {
+        pool.threads.emplace_back( [&pool]() {
+            t_pool = &pool;
+            std::unique_lock< std::mutex > lock( pool.mutex );
+            for( ;; ) {
+                pool.changed.wait( lock, [&]() { return pool.quit || pool.tasks.size(); } );
+                if ( pool.quit ) return;
+                auto task = std::move( pool.tasks.front() );
+                pool.tasks.pop_front();
+                lock.unlock();
+                baker_runTask( task );
+                lock.lock();
+            }
+        } );
+    }
+}
+
+BakerThreadPool* baker_createPool( int numThreads )
+{
+    auto pool = new BakerThreadPool;
+    pool->numThreads = std::max( 0, numThreads );
+    return pool;
+}
+
+void baker_destroyPool( BakerThreadPool* pool )
+{
+    baker_stopPool( *pool );
+    delete pool;
+}
+
+void baker_withPool( BakerThreadPool* pool, BakerCancel* cancel, std::function< void() > func )
+{
+    auto prevPool = t_pool;
+    auto prevCancel = t_cancel;
+    t_pool = pool;
+    t_cancel = cancel;
+    func();
+    t_pool = prevPool;
+    t_cancel = prevCancel;
+}
+
+void baker_setNumThreads( int numThreads )
+{
+    // Only called between bakes, so the pool is idle and can be rebuilt at the new size.
+    baker_stopPool( s_defaultPool );
+    s_defaultPool.numThreads = std::max( 0, numThreads );
+}
+
+int baker_numThreads()
+{
+    return baker_poolThreads( baker_currentPool() );
+}
+
+void baker_submit( std::function< void() > func )
+{
+    auto& pool = baker_currentPool();
+    baker_startPool( pool );
+    {
+        std::lock_guard< std::mutex > lock( pool.mutex );
+        pool.tasks.push_back( { std::move( func ), t_cancel } );
+    }
+    pool.changed.notify_all();
+}
+
+// Wakes threads waiting in baker_waitFor. Taking the lock orders this after any waiter's last check.
+void baker_notify()
+{
+    auto& pool = baker_currentPool();
+    {
+        std::lock_guard< std::mutex > lock( pool.mutex );
+    }
+    pool.changed.notify_all();
+}
+
+void baker_waitFor( std::function< bool() > done )
+{
+    auto& pool = baker_currentPool();
+    std::unique_lock< std::mutex > lock( pool.mutex );
+    while ( !done() ) {
+        if ( pool.tasks.size() ) {
+            auto task = std::move( pool.tasks.front() );
+            pool.tasks.pop_front();
+            lock.unlock();
+            baker_runTask( task );
+            lock.lock();
+            continue;
+        }
+        pool.changed.wait( lock );
+    }
+}
+
+struct BakerLoop
+{
+    std::atomic< int > nextIdx;
+    std::atomic< int > numDone;
+    int count;
+    std::function< void( int idx ) >* func;
+};
+
+void baker_parallelFor( int count, std::function< void( int idx ) > func )
+{
+    int numThreads = std::max( 1, std::min( baker_numThreads(), count ) );
+    if ( numThreads == 1 ) {
+        for( int idx = 0; idx < count && !baker_cancelled(); idx++ ) {
+            func( idx );
+        }
+        return;
+    }
+
+    // Helpers that only get to run once every index is taken find nothing left and return without touching func.
+    // Once cancelled, the remaining indices are still taken but skipped.
+    auto loop = std::make_shared< BakerLoop >();
+    loop->nextIdx = 0;
+    loop->numDone = 0;
+    loop->count = count;
+    loop->func = &func;
+    auto worker = [loop]() {
+        for( int idx = loop->nextIdx++; idx < loop->count; idx = loop->nextIdx++ ) {
+            if ( !baker_cancelled() ) ( *loop->func )( idx );
+            if ( ++loop->numDone == loop->count ) baker_notify();
+        }
+    };
+    for( int i = 1; i < numThreads; i++ ) {
+        baker_submit( worker );
+    }
+    worker();
+    baker_waitFor( [&]() { return loop->numDone == count; } );
+}
+
+int baker_addJob( BakeGraph& graph, std::string name, std::function< void() > func, std::vector< int > dependencies )
+{
+    int id = int( graph.jobs.size() );
+    for( int d : dependencies ) {
+        assert( d >= 0 && d < id );
+    }
+    graph.jobs.push_back( { name, func, dependencies } );
+    return id;
+}
+
+// Jobs are queued as soon as their last dependency finishes; the calling thread helps until all are done. Jobs
+// that haven't started when the bake is cancelled are skipped.
+//
+void baker_runGraph( const BakeGraph& graph )
+{
+    int numJobs = int( graph.jobs.size() );
+    std::vector< std::vector< int > > dependents( numJobs );
+    std::unique_ptr< std::atomic< int >[] > numWaiting( new std::atomic< int >[numJobs] );
+    for( int j = 0; j < numJobs; j++ ) {
+        numWaiting[j] = int( graph.jobs[j].dependencies.size() );
+        for( int d : graph.jobs[j].dependencies ) {
+            dependents[d].push_back( j );
+        }
+    }
+
+    std::atomic< int > numDone( 0 );
+    std::function< void( int ) > submit = [&]( int j ) {
+        baker_submit( [&, j]() {
+            if ( !baker_cancelled() ) {
+                BAKER_TRACE_SCOPE( graph.jobs[j].name );
+                graph.jobs[j].func();
+            }
+            baker_traceCounters();
+            for( int d : dependents[j] ) {
+                if ( --numWaiting[d] == 0 ) submit( d );
+            }
+            if ( ++numDone == numJobs ) baker_notify();
+        } );
+    };
+    // Roots are picked before any job runs, as running jobs bring the counts of their dependents to 0 as well.
+    std::vector< int > roots;
+    for( int j = 0; j < numJobs; j++ ) {
+        if ( numWaiting[j] == 0 ) roots.push_back( j );
+    }
+    for( int j : roots ) {
+        submit( j );
+    }
+    baker_waitFor( [&]() { return numDone == numJobs; } );
+}
@@ -0,0 +1,155 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "libpbrbaker.h"
+#include "gloss_normal.h"
+
+using namespace glm;
+
+struct PbrBaker
+{
+    BakerThreadPool* pool;
+    ManifestCache* cache;
+    BakerCancel cancel;
+};
+
+PbrBaker* pbrbaker_Create( int numThreads )
+{
+    auto baker = new PbrBaker;
+    baker->pool = baker_createPool( numThreads );
+    baker->cache = manifest_CreateCache( PBRBAKER_CACHE_TEXELS );
+    return baker;
+}
+
+void pbrbaker_Destroy( PbrBaker* baker )
+{
+    baker_destroyPool( baker->pool );
+    manifest_DestroyCache( baker->cache );
+    delete baker;
+}
+
+void pbrbaker_Cancel( PbrBaker* baker )
+{
+    baker->cancel.requested = true;
+}
+
+void pbrbaker_ClearCancel( PbrBaker* baker )
+{
+    baker->cancel.requested = false;
+}
+
+// A cancel stays pending until a run picks it up, so one issued just before the run starts isn't lost. The run
+// only fails if its bake saw the cancel; one landing after the last check leaves finished results, and is dropped.
+//
+bool pbrbaker_Run( PbrBaker* baker, std::function< void() > func )
+{
+    baker->cancel.seen = false;
+    baker_withPool( baker->pool, &baker->cancel, func );
+    bool cancelled = baker->cancel.seen;
+    baker->cancel.requested = false;
+    return !cancelled;
+}
+
+int pbrbaker_ImageChannels( const ManifestOutput& output )
+{
+    return output.channels.empty() ? 4 : int( output.channels.size() );
+}
+
+bool pbrbaker_BakeImages( PbrBaker* baker, std::vector< ManifestOutput > outputs, const std::vector< float* >& buffers,
+                          PbrBakerOutputDone done, PbrBakerPreview preview, double previewSeconds )
+{
+    if ( outputs.size() != buffers.size() ) {
+        return false;
+    }
+    for( auto& output : outputs ) {
+        if ( !manifest_CheckOutput( "pbrbaker", output ) ) return false;
+    }
+
+    ManifestPreview outputPreview = nullptr;
+    if ( preview ) {
+        outputPreview = [&]( int o, const std::vector< vec4 >& pixels, int /*numChannels*/, float fraction ) { preview( o, pixels, fraction ); };
+    }
+    return pbrbaker_Run( baker, [&]() {
+        BakeGraph graph;
+        bake_manifest( graph, outputs, [&]( int o, const std::vector< vec4 >& pixels, int numChannels ) {
+            float* out = buffers[o];
+            for( auto& texel : pixels ) {
+                out = std::copy( &texel[0], &texel[0] + numChannels, out );
+            }
+            if ( done ) done( o );
+        }, baker->cache, outputPreview, previewSeconds );
+        baker_runGraph( graph );
+    } );
+}
+
+bool pbrbaker_BakeImage( PbrBaker* baker, const ManifestOutput& output, float* buffer )
+{
+    return pbrbaker_BakeImages( baker, { output }, { buffer } );
+}
+
+bool pbrbaker_SampleSequence( PbrBaker* baker, std::string name, int numSamples, int numDims, uint32_t seed, uint32_t* points )
+{
+    SampleSequence sequence;
+    if ( !sampling_ParseSequence( name, sequence ) || numSamples < 1 || numDims < 1 ) {
+        return false;
+    }
+    if ( ( sequence == SAMPLE_SEQUENCE_SOBOL || sequence == SAMPLE_SEQUENCE_SOBOL_OWEN ) && numDims > SAMPLING_SOBOL_MAX_DIMS ) {
+        return false;
+    }
+    return pbrbaker_Run( baker, [&]() {
+        std::vector< uint32_t > generated;
+        sampling_Generate( sequence, numSamples, numDims, seed, generated );
+        std::copy( generated.begin(), generated.end(), points );
+    } );
+}
+
+bool pbrbaker_ScramblingTiles( PbrBaker* baker, const SampleTileSettings& settings, SampleTiles& tiles )
+{
+    return pbrbaker_Run( baker, [&]() { sampling_OptimizeScramblingTiles( settings, false, tiles ); } );
+}
+
+bool pbrbaker_GlossNormalLengths( PbrBaker* baker, int numSamples, float* lengths )
+{
+    if ( numSamples < 1 ) {
+        return false;
+    }
+    return pbrbaker_Run( baker, [&]() {
+        auto normalLengths = glossNormal_IntegrateNormalLengths( numSamples );
+        std::copy( normalLengths.begin(), normalLengths.end(), lengths );
+    } );
+}
+
+bool pbrbaker_BurleyProfile( PbrBaker* baker, const PssProfileSettings& settings, int res, vec4* slices )
+{
+    if ( res < 2 ) {
+        return false;
+    }
+    return pbrbaker_Run( baker, [&]() {
+        std::vector< std::vector< vec4 > > tables;
+        pss_BakeBurleyTables( res, settings, tables );
+        for( auto& table : tables ) {
+            slices = std::copy( table.begin(), table.end(), slices );
+        }
+    } );
+}
+
+bool pbrbaker_RunGraph( PbrBaker* baker, const BakeGraph& graph )
+{
+    return pbrbaker_Run( baker, [&]() { baker_runGraph( graph ); } );
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+#include "manifest.h"
+#include "sampling.h"
+#include "subsurface.h"
+
+// Embedding API, for tools that want baked data in memory rather than as files. Bakes run on the handle's own
+// thread pool and fill caller provided buffers. Calls block until the bake is done, and return false if it was
+// cancelled or its parameters are invalid, leaving the buffers undefined. One call at a time per handle; separate
+// handles bake concurrently.
+//
+// Each handle keeps up to PBRBAKER_CACHE_TEXELS of baked image tables between calls, so baking again with a few
+// changed parameters only bakes the tables those parameters feed.
+//
+#define PBRBAKER_CACHE_TEXELS ( 16 << 20 )
+
+struct PbrBaker;
+
+PbrBaker* pbrbaker_Create( int numThreads ); // 0 for all hardware threads.
+void pbrbaker_Destroy( PbrBaker* baker );
+
+// Safe from any thread. Stops the call running on the handle as soon as possible, or if none is running, the next
+// call to start. The cancel is cleared when the running call returns, or by pbrbaker_ClearCancel, for callers
+// that only mean to stop the work they have already started. Calls only return false for a cancel their bake
+// acted on; one arriving after the work was done leaves the results intact.
+void pbrbaker_Cancel( PbrBaker* baker );
+void pbrbaker_ClearCancel( PbrBaker* baker );
+
+// Tables and channel packing as listed in manifest.h; paths are ignored. Each buffer is filled with resolution x
+// resolution texels of pbrbaker_ImageChannels floats, in the layout of baker_writeImage2D. Tables shared
+// between outputs are baked once. Done is called from a worker thread as soon as each output's buffer is filled,
+// for callers that want to use outputs before the rest are baked.
+//
+// With a preview, BRDF and gloss tables bake coarse to fine, and preview is called about every previewSeconds with
+// the refined output so far, as for bake_manifest: pbrbaker_ImageChannels channels of each texel set, channels
+// from tables that don't refine 0. Calls come from worker threads, one at a time.
+typedef std::function< void( int output ) > PbrBakerOutputDone;
+typedef std::function< void( int output, const std::vector< glm::vec4 >& pixels, float fraction ) > PbrBakerPreview;
+int pbrbaker_ImageChannels( const ManifestOutput& output );
+bool pbrbaker_BakeImages( PbrBaker* baker, std::vector< ManifestOutput > outputs, const std::vector< float* >& buffers,
+                          PbrBakerOutputDone done = nullptr, PbrBakerPreview preview = nullptr, double previewSeconds = 0.5 );
+bool pbrbaker_BakeImage( PbrBaker* baker, const ManifestOutput& output, float* buffer );
+
+// numSamples x numDims points in 32-bit fixed point, for the sequence names of sampling_ParseSequence.
+bool pbrbaker_SampleSequence( PbrBaker* baker, std::string name, int numSamples, int numDims, uint32_t seed, uint32_t* points );
+
+// Not checkpointed, so a cancelled optimization starts over.
+bool pbrbaker_ScramblingTiles( PbrBaker* baker, const SampleTileSettings& settings, SampleTiles& tiles );
+
+// 256 average normal lengths over gloss in [ 0, 1 ].
+bool pbrbaker_GlossNormalLengths( PbrBaker* baker, int numSamples, float* lengths );
+
+// max( settings.numSlices, 1 ) Burley profile tables of res x res texels, one after another.
+bool pbrbaker_BurleyProfile( PbrBaker* baker, const PssProfileSettings& settings, int res, glm::vec4* slices );
+
+// Runs bake_* jobs, which write their usual output files, on the handle's pool.
+bool pbrbaker_RunGraph( PbrBaker* baker, const BakeGraph& graph );
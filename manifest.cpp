@@ -0,0 +1,595 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "manifest.h"
+#include "env_brdf.h"
+#include "multiscatter_brdf.h"
+#include "gloss_normal.h"
+#include "blackbody.h"
+#include "subsurface.h"
+#include "noise.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace glm;
+
+// Tables in the same group come out of one bake, and are cached together.
+//
+struct ManifestTable
+{
+    const char* name;
+    const char* group;
+    int index;              // Into the tables baked by the group.
+    int defaultResolution;
+    int minResolution;
+    int maxResolution;
+    int defaultSamples;     // 0 for tables that aren't integrated.
+    bool seeded;
+};
+
+static const ManifestTable s_manifestTables[] = {
+    { "env_brdf",                       "env_brdf",              0, 256, 2,                 16384, ENVBRDF_SAMPLE_SIZE,     false },
+    { "env_brdf_multiscatter",          "env_brdf_multiscatter", 0, 256, 2,                 16384, ENVBRDF_SAMPLE_SIZE,     false },
+    { "env_brdf_fit",                   "env_brdf_fit",          0, 256, 2,                 16384, 0,                       false },
+    { "brdf_Fd0",                       "brdf_Fd0",              0, 128, 2,                 16384, 0,                       false },
+    { "brdf_Fd1",                       "brdf_Fd1",              0, 128, 2,                 16384, 0,                       false },
+    { "brdf_FdR",                       "brdf_FdR",              0, 128, 2,                 16384, 0,                       false },
+    { "gloss_combine",                  "gloss_combine",         0, 256, 2,                 16384, GLOSSNORMAL_SAMPLE_SIZE, false },
+    { "planck_blackbody",               "planck_blackbody",      0, 256, 2,                 16384, BLACKBODY_SAMPLE_SIZE,   false },
+    { "subsurface_gaussian",            "subsurface",            0, 256, 2,                 16384, PSS_NUM_SAMPLES,         false },
+    { "subsurface_smoothstep",          "subsurface",            1, 256, 2,                 16384, PSS_NUM_SAMPLES,         false },
+    { "subsurface_penner",              "subsurface",            2, 256, 2,                 16384, PSS_NUM_SAMPLES,         false },
+    { "subsurface_penumbra_gaussian",   "subsurface",            3, 256, 2,                 16384, PSS_NUM_SAMPLES,         false },
+    { "subsurface_penumbra_smoothstep", "subsurface",            4, 256, 2,                 16384, PSS_NUM_SAMPLES,         false },
+    { "subsurface_penumbra_penner",     "subsurface",            5, 256, 2,                 16384, PSS_NUM_SAMPLES,         false },
+    { "white_noise",                    "white_noise",           0, 128, 1,                 16384, 0,                       true  },
+    { "blue_noise",                     "blue_noise",            0, 128, BLUENOISE_MIN_RES, 4096,  0,                       true  },
+    { "perlin",                         "perlin",                0, 256, 1,                 16384, 0,                       true  },
+    { "fbm",                            "fbm",                   0, 256, 1,                 16384, 0,                       true  },
+    { "ridged",                         "ridged",                0, 256, 1,                 16384, 0,                       true  },
+    { "turbulence",                     "turbulence",            0, 256, 1,                 16384, 0,                       true  },
+};
+
+const ManifestTable* manifest_FindTable( const std::string& name )
+{
+    for( auto& table : s_manifestTables ) {
+        if ( name == table.name ) return &table;
+    }
+    return nullptr;
+}
+
+std::vector< std::string > manifest_TableNames()
+{
+    std::vector< std::string > names;
+    for( auto& table : s_manifestTables ) {
+        names.push_back( table.name );
+    }
+    return names;
+}
+
+bool manifest_IsPerlin( const ManifestTable& table )
+{
+    PerlinNoiseType type;
+    return noisegen_parsePerlinType( table.group, type );
+}
+
+// Everything a group's tables depend on. Parameters a group doesn't use stay 0, so they don't split the cache.
+//
+struct ManifestParams
+{
+    int resolution = 0;
+    int samples = 0;
+    uint32_t seed = 0;
+    int numChannels = 0;    // Independent blue noise channels.
+    int perlinPeriod = 0;
+    int perlinOctaves = 0;
+    float perlinGain = 0.0f;
+};
+
+typedef std::vector< std::vector< vec4 > > ManifestTables;
+
+ManifestParams manifest_TableParams( const ManifestTable& table, const ManifestOutput& output )
+{
+    ManifestParams params;
+    params.resolution = output.resolution ? output.resolution : table.defaultResolution;
+    params.samples = table.defaultSamples ? ( output.samples ? output.samples : table.defaultSamples ) : 0;
+    params.seed = table.seeded ? output.seed : 0;
+    if ( manifest_IsPerlin( table ) ) {
+        params.perlinPeriod = output.perlinPeriod;
+        params.perlinOctaves = output.perlinOctaves;
+        params.perlinGain = output.perlinGain;
+    }
+    return params;
+}
+
+std::string manifest_CacheKey( const ManifestTable& table, const ManifestParams& params )
+{
+    char key[256];
+    snprintf( key, sizeof( key ), "%s@%d/%d/%u/%d/%d/%g", table.group, params.resolution, params.samples, params.seed,
+              params.perlinPeriod, params.perlinOctaves, params.perlinGain );
+    return key;
+}
+
+// Tables of 2D functions are evaluated progressively when previewed, refining tables[0] coarse to fine.
+//
+void manifest_BakeGroup( const std::string& group, const ManifestParams& params, ManifestTables& tables, double previewSeconds, BakerPreview preview )
+{
+    int res = params.resolution;
+    tables.resize( 1 );
+    auto evaluate = [&]( std::function< vec4( float x, float y ) > func ) {
+        if ( preview ) {
+            baker_evaluateImage2DProgressive( func, res, tables[0], previewSeconds, preview );
+        } else {
+            baker_evaluateImage2D( func, res, tables[0] );
+        }
+    };
+
+    if ( group == "env_brdf" || group == "env_brdf_multiscatter" ) {
+        bool multiscatter = group == "env_brdf_multiscatter";
+        evaluate( [&]( float x, float y ) { return ggx_IntegrateBRDF_Function( x, y, multiscatter, params.samples ); } );
+    } else if ( group == "env_brdf_fit" ) {
+        evaluate( ggx_EvalGitEnvBRDF );
+    } else if ( group == "brdf_Fd0" ) {
+        evaluate( multiscatterBRDF_roughFoundationFunction );
+    } else if ( group == "brdf_Fd1" ) {
+        evaluate( multiscatterBRDF_disneyDiffuseRough );
+    } else if ( group == "brdf_FdR" ) {
+        evaluate( multiscatterBRDF_retroReflectiveBump );
+    } else if ( group == "gloss_combine" ) {
+        auto normalLengths = glossNormal_IntegrateNormalLengths( params.samples );
+        evaluate( [&]( float x, float y ) { return glossNormal_GenerateGlossCombineTable( normalLengths, x, y ); } );
+    } else if ( group == "planck_blackbody" ) {
+        blackbody_EvaluateImage( res, params.samples, tables[0] );
+    } else if ( group == "subsurface" ) {
+        ManifestTables penumbraTables;
+        pss_BakeKernelTables( res, params.samples, tables, penumbraTables );
+        tables.insert( tables.end(), penumbraTables.begin(), penumbraTables.end() );
+    } else if ( group == "white_noise" ) {
+        noisegen_whiteNoisePixels( res, params.seed, tables[0] );
+    } else if ( group == "blue_noise" ) {
+        noisegen_blueNoiseImage( res, params.numChannels, params.seed, tables[0] );
+    } else {
+        PerlinNoiseType type;
+        bool isPerlin = noisegen_parsePerlinType( group, type );
+        assert( isPerlin );
+        NoiseSettings settings;
+        settings.seed = params.seed;
+        settings.perlinPeriod = params.perlinPeriod;
+        settings.perlinOctaves = params.perlinOctaves;
+        settings.perlinGain = params.perlinGain;
+        noisegen_perlinImage( type, settings, res, 0, tables[0] );
+    }
+}
+
+std::string manifest_Trim( const std::string& s )
+{
+    auto first = s.find_first_not_of( " \t\r\n" );
+    if ( first == std::string::npos ) return "";
+    auto last = s.find_last_not_of( " \t\r\n" );
+    return s.substr( first, last - first + 1 );
+}
+
+// Tokens are separated by spaces or commas. Without a table, each letter of a token is a channel of the output's
+// own table, so rg and r g are the same.
+//
+bool manifest_ParseChannels( const std::string& value, std::vector< ManifestChannel >& channels )
+{
+    const std::string channelNames = "rgba";
+    std::string spaced = value;
+    std::replace( spaced.begin(), spaced.end(), ',', ' ' );
+
+    channels.clear();
+    size_t pos = 0;
+    while ( ( pos = spaced.find_first_not_of( " \t", pos ) ) != std::string::npos ) {
+        size_t end = spaced.find_first_of( " \t", pos );
+        std::string token = spaced.substr( pos, end == std::string::npos ? std::string::npos : end - pos );
+        pos = end == std::string::npos ? spaced.size() : end;
+
+        size_t parsed = 0;
+        ManifestChannel channel;
+        try {
+            channel.value = std::stof( token, &parsed );
+        } catch ( ... ) {
+            parsed = 0;
+        }
+        if ( parsed == token.size() && token.find( '.' ) != std::string::npos ) {
+            channel.channel = -1;
+            channels.push_back( channel );
+            continue;
+        }
+
+        auto dot = token.rfind( '.' );
+        if ( dot != std::string::npos ) {
+            auto c = token.substr( dot + 1 );
+            if ( c.size() != 1 || channelNames.find( c[0] ) == std::string::npos ) return false;
+            channel.table = token.substr( 0, dot );
+            channel.channel = int( channelNames.find( c[0] ) );
+            channels.push_back( channel );
+            continue;
+        }
+
+        for( char c : token ) {
+            ManifestChannel swizzle;
+            if ( c == '0' || c == '1' ) {
+                swizzle.channel = -1;
+                swizzle.value = float( c - '0' );
+            } else if ( channelNames.find( c ) != std::string::npos ) {
+                swizzle.channel = int( channelNames.find( c ) );
+            } else {
+                return false;
+            }
+            channels.push_back( swizzle );
+        }
+    }
+    return channels.size() >= 1 && channels.size() <= 4;
+}
+
+bool manifest_CheckOutput( std::string source, ManifestOutput& output )
+{
+    auto error = [&]( const char* what, const std::string& detail ) {
+        printf( "%s: [%s] %s %s, skipping.\n", source.c_str(), output.name.c_str(), what, detail.c_str() );
+        return false;
+    };
+
+    if ( output.table.empty() ) output.table = output.name;
+    if ( output.path.empty() ) output.path = "output/" + output.name + ".png";
+
+    auto table = manifest_FindTable( output.table );
+    if ( !table ) return error( "unknown table", output.table );
+
+    namespace fs = std::experimental::filesystem;
+    auto ext = fs::path( output.path ).extension().u8string();
+    if ( ext != ".png" && ext != ".bmp" && ext != ".tga" && ext != ".hdr" ) return error( "unknown image format", output.path );
+
+    if ( !output.resolution ) output.resolution = table->defaultResolution;
+    if ( output.samples < 0 ) return error( "negative samples", std::to_string( output.samples ) );
+    if ( output.perlinPeriod < 1 || ( output.perlinPeriod & ( output.perlinPeriod - 1 ) ) ) {
+        return error( "perlin period isn't a power of two", std::to_string( output.perlinPeriod ) );
+    }
+    if ( output.perlinOctaves < 1 ) return error( "perlin octaves below 1", std::to_string( output.perlinOctaves ) );
+
+    std::vector< const ManifestTable* > tables = { table };
+    for( auto& channel : output.channels ) {
+        if ( channel.table.empty() ) continue;
+        auto other = manifest_FindTable( channel.table );
+        if ( !other ) return error( "unknown table", channel.table );
+        tables.push_back( other );
+    }
+    for( auto other : tables ) {
+        if ( output.resolution < other->minResolution || output.resolution > other->maxResolution ) {
+            return error( "resolution out of range for", other->name );
+        }
+        // Integrators space their samples over numSamples - 1 intervals.
+        if ( other->defaultSamples && output.samples == 1 ) {
+            return error( "fewer than 2 samples for", other->name );
+        }
+    }
+    return true;
+}
+
+void manifest_Parse( std::istream& in, std::string source, std::vector< ManifestOutput >& outputs )
+{
+    std::vector< ManifestOutput > sections;
+    std::vector< bool > valid;
+    std::string line;
+    for( int lineNumber = 1; std::getline( in, line ); lineNumber++ ) {
+        auto comment = line.find_first_of( ";#" );
+        if ( comment != std::string::npos ) line.resize( comment );
+        line = manifest_Trim( line );
+        if ( line.empty() ) continue;
+
+        auto lineError = [&]( const char* what ) {
+            printf( "%s:%d: %s, skipping [%s].\n", source.c_str(), lineNumber, what, sections.size() ? sections.back().name.c_str() : "" );
+            if ( valid.size() ) valid.back() = false;
+        };
+
+        if ( line.front() == '[' ) {
+            if ( line.back() != ']' || line.size() < 3 ) {
+                printf( "%s:%d: bad section header %s, skipping section.\n", source.c_str(), lineNumber, line.c_str() );
+            }
+            sections.emplace_back();
+            sections.back().name = manifest_Trim( line.substr( 1, line.size() - 2 ) );
+            valid.push_back( line.back() == ']' && line.size() >= 3 );
+            continue;
+        }
+
+        auto equals = line.find( '=' );
+        if ( sections.empty() ) {
+            printf( "%s:%d: key outside of a section, ignored.\n", source.c_str(), lineNumber );
+            continue;
+        }
+        if ( equals == std::string::npos ) {
+            lineError( "expected key = value" );
+            continue;
+        }
+
+        auto& output = sections.back();
+        auto key = manifest_Trim( line.substr( 0, equals ) );
+        auto value = manifest_Trim( line.substr( equals + 1 ) );
+        try {
+            if ( key == "table" ) {
+                output.table = value;
+            } else if ( key == "path" ) {
+                output.path = value;
+            } else if ( key == "resolution" ) {
+                output.resolution = std::stoi( value );
+            } else if ( key == "samples" ) {
+                output.samples = std::stoi( value );
+            } else if ( key == "seed" ) {
+                output.seed = uint32_t( std::stoul( value ) );
+            } else if ( key == "period" ) {
+                output.perlinPeriod = std::stoi( value );
+            } else if ( key == "octaves" ) {
+                output.perlinOctaves = std::stoi( value );
+            } else if ( key == "gain" ) {
+                output.perlinGain = std::stof( value );
+            } else if ( key == "channels" ) {
+                if ( !manifest_ParseChannels( value, output.channels ) ) lineError( "expected 1 to 4 channels" );
+            } else {
+                lineError( ( "unknown key " + key ).c_str() );
+            }
+        } catch ( ... ) {
+            lineError( ( "bad value for " + key ).c_str() );
+        }
+    }
+
+    // Two outputs writing one file would race, and only the last to finish would be kept.
+    namespace fs = std::experimental::filesystem;
+    std::map< std::string, std::string > paths;
+    for( int i = 0; i < int( sections.size() ); i++ ) {
+        if ( !valid[i] || !manifest_CheckOutput( source, sections[i] ) ) continue;
+        auto path = fs::absolute( sections[i].path ).u8string();
+        auto other = paths.find( path );
+        if ( other != paths.end() ) {
+            printf( "%s: [%s] path %s is already written by [%s], skipping.\n", source.c_str(), sections[i].name.c_str(),
+                    sections[i].path.c_str(), other->second.c_str() );
+            continue;
+        }
+        paths[path] = sections[i].name;
+        outputs.push_back( sections[i] );
+    }
+}
+
+bool manifest_Load( std::string fileName, std::vector< ManifestOutput >& outputs )
+{
+    std::ifstream f( fileName );
+    if ( !f.is_open() ) {
+        return false;
+    }
+    manifest_Parse( f, fileName, outputs );
+    return true;
+}
+
+// Least recently used tables are dropped to make room, and tables bigger than the whole budget aren't kept.
+//
+struct ManifestCache
+{
+    struct Entry
+    {
+        std::shared_ptr< ManifestTables > tables;
+        size_t texels;
+        uint64_t lastUsed;
+    };
+
+    std::mutex mutex;
+    std::map< std::string, Entry > entries;
+    size_t maxTexels;
+    size_t texels = 0;
+    uint64_t clock = 0;
+};
+
+ManifestCache* manifest_CreateCache( size_t maxTexels )
+{
+    auto cache = new ManifestCache;
+    cache->maxTexels = maxTexels;
+    return cache;
+}
+
+void manifest_DestroyCache( ManifestCache* cache )
+{
+    delete cache;
+}
+
+BAKER_TRACE_COUNTER( s_cacheHits, "manifest cache hits" );
+BAKER_TRACE_COUNTER( s_cacheMisses, "manifest cache misses" );
+
+std::shared_ptr< ManifestTables > manifest_CacheFind( ManifestCache* cache, const std::string& key )
+{
+    std::lock_guard< std::mutex > lock( cache->mutex );
+    auto found = cache->entries.find( key );
+    if ( found == cache->entries.end() ) {
+        BAKER_TRACE_COUNT( s_cacheMisses, 1 );
+        return nullptr;
+    }
+    BAKER_TRACE_COUNT( s_cacheHits, 1 );
+    found->second.lastUsed = ++cache->clock;
+    return found->second.tables;
+}
+
+void manifest_CacheInsert( ManifestCache* cache, const std::string& key, std::shared_ptr< ManifestTables > tables )
+{
+    size_t texels = 0;
+    for( auto& table : *tables ) texels += table.size();
+
+    std::lock_guard< std::mutex > lock( cache->mutex );
+    if ( texels > cache->maxTexels || cache->entries.count( key ) ) {
+        return;
+    }
+    while ( cache->texels + texels > cache->maxTexels ) {
+        auto oldest = cache->entries.begin();
+        for( auto entry = cache->entries.begin(); entry != cache->entries.end(); ++entry ) {
+            if ( entry->second.lastUsed < oldest->second.lastUsed ) oldest = entry;
+        }
+        cache->texels -= oldest->second.texels;
+        cache->entries.erase( oldest );
+    }
+    cache->entries[key] = { tables, texels, ++cache->clock };
+    cache->texels += texels;
+}
+
+// Every distinct table bake is one job, and every output a job waiting on the bakes it packs channels from.
+// Blue noise channels are ranked independently, so its bakes rank as many channels as outputs read from them.
+// Bakes found in the cache get no job at all. Previews of a bake are packed into every output reading from it,
+// one at a time.
+//
+void bake_manifest( BakeGraph& graph, const std::vector< ManifestOutput >& outputs, ManifestSink sink, ManifestCache* cache,
+                    ManifestPreview preview, double previewSeconds )
+{
+    struct GroupBake
+    {
+        std::string key;
+        std::string group;
+        ManifestParams params;
+        std::shared_ptr< ManifestTables > tables;
+    };
+    struct ChannelSource
+    {
+        int bake;       // -1 for a constant.
+        int table;
+        int channel;
+        float value;
+    };
+
+    std::vector< GroupBake > bakes;
+    std::map< std::string, int > bakeIndices;
+    std::vector< std::vector< ChannelSource > > outputSources( outputs.size() );
+    std::vector< ManifestOutput > resolved = outputs;
+    for( int o = 0; o < int( outputs.size() ); o++ ) {
+        auto& output = resolved[o];
+        if ( !output.resolution ) output.resolution = manifest_FindTable( output.table )->defaultResolution;
+        auto channels = output.channels;
+        bool swizzled = !channels.empty();
+        if ( !swizzled ) {
+            channels.resize( 4 );
+            for( int c = 0; c < 4; c++ ) channels[c].channel = c;
+        }
+
+        for( auto& channel : channels ) {
+            if ( channel.channel < 0 ) {
+                outputSources[o].push_back( { -1, 0, 0, channel.value } );
+                continue;
+            }
+            auto table = manifest_FindTable( channel.table.empty() ? output.table : channel.table );
+            assert( table );
+            auto params = manifest_TableParams( *table, output );
+            auto key = manifest_CacheKey( *table, params );
+            auto found = bakeIndices.find( key );
+            if ( found == bakeIndices.end() ) {
+                found = bakeIndices.emplace( key, int( bakes.size() ) ).first;
+                bakes.push_back( { key, table->group, params, std::make_shared< ManifestTables >() } );
+            }
+            auto& bake = bakes[found->second];
+            bake.params.numChannels = max( bake.params.numChannels, swizzled ? channel.channel + 1 : 1 );
+            outputSources[o].push_back( { found->second, table->index, channel.channel, 0.0f } );
+        }
+    }
+
+    // Without a sink, outputs are previewed next to their paths when the CLI asks for previews.
+    bool previewFiles = !sink && !preview && baker_previewInterval() > 0.0;
+    if ( previewFiles ) {
+        previewSeconds = baker_previewInterval();
+        preview = [=]( int o, const std::vector< vec4 >& pixels, int numChannels, float fraction ) {
+            baker_writePreview2D( pixels, resolved[o].resolution, resolved[o].path, numChannels, fraction );
+        };
+    }
+    auto previewMutex = std::make_shared< std::mutex >();
+
+    std::vector< int > bakeJobs( bakes.size(), -1 );
+    for( int b = 0; b < int( bakes.size() ); b++ ) {
+        auto bake = bakes[b];
+        if ( bake.group != "blue_noise" ) bake.params.numChannels = 0;
+        auto cacheKey = bake.key + "/" + std::to_string( bake.params.numChannels );
+        auto cached = cache ? manifest_CacheFind( cache, cacheKey ) : nullptr;
+        if ( cached ) {
+            printf( "Reusing cached %dx%d %s tables.\n", bake.params.resolution, bake.params.resolution, bake.group.c_str() );
+            bakes[b].tables = cached;
+            continue;
+        }
+
+        BakerPreview bakePreview = nullptr;
+        if ( preview ) {
+            std::vector< int > previewed;
+            for( int o = 0; o < int( outputs.size() ); o++ ) {
+                for( auto& source : outputSources[o] ) {
+                    if ( source.bake == b ) {
+                        previewed.push_back( o );
+                        break;
+                    }
+                }
+            }
+            // Channels from other bakes stay 0 until the output is packed.
+            bakePreview = [=]( const std::vector< vec4 >& pixels, float fraction ) {
+                for( int o : previewed ) {
+                    auto& sources = outputSources[o];
+                    std::vector< vec4 > packed( pixels.size(), vec4( 0.0f ) );
+                    for( int c = 0; c < int( sources.size() ); c++ ) {
+                        auto& source = sources[c];
+                        for( int i = 0; i < int( pixels.size() ); i++ ) {
+                            packed[i][c] = source.bake < 0 ? source.value : source.bake == b ? pixels[i][source.channel] : 0.0f;
+                        }
+                    }
+                    std::lock_guard< std::mutex > lock( *previewMutex );
+                    preview( o, packed, int( sources.size() ), fraction );
+                }
+            };
+        }
+
+        bakeJobs[b] = baker_addJob( graph, bake.key, [=]() {
+            printf( "Baking %dx%d %s tables ...\n", bake.params.resolution, bake.params.resolution, bake.group.c_str() );
+            manifest_BakeGroup( bake.group, bake.params, *bake.tables, previewSeconds, bakePreview );
+            if ( cache && !baker_cancelled() ) {
+                manifest_CacheInsert( cache, cacheKey, bake.tables );
+            }
+        } );
+    }
+
+    for( int o = 0; o < int( outputs.size() ); o++ ) {
+        auto output = resolved[o];
+        auto sources = outputSources[o];
+        std::vector< int > dependencies;
+        std::vector< std::shared_ptr< ManifestTables > > tables;
+        for( auto& source : sources ) {
+            tables.push_back( source.bake < 0 ? nullptr : bakes[source.bake].tables );
+            if ( source.bake >= 0 && bakeJobs[source.bake] >= 0 && std::find( dependencies.begin(), dependencies.end(), bakeJobs[source.bake] ) == dependencies.end() ) {
+                dependencies.push_back( bakeJobs[source.bake] );
+            }
+        }
+
+        baker_addJob( graph, output.name, [=]() {
+            printf( "Packing manifest output %s ...\n", output.name.c_str() );
+            int res = output.resolution;
+            std::vector< vec4 > pixels( res * res, vec4( 0.0f ) );
+            for( int c = 0; c < int( sources.size() ); c++ ) {
+                auto& source = sources[c];
+                for( int i = 0; i < res * res; i++ ) {
+                    pixels[i][c] = source.bake < 0 ? source.value : ( *tables[c] )[source.table][i][source.channel];
+                }
+            }
+            if ( sink ) {
+                sink( o, pixels, int( sources.size() ) );
+            } else {
+                baker_writeImage2D( pixels, res, output.path, int( sources.size() ) );
+                if ( previewFiles ) baker_removePreview2D( output.path );
+            }
+        }, dependencies );
+    }
+}
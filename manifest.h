@@ -0,0 +1,90 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+#include <istream>
+
+// A bake manifest lists output images, one INI section each, instead of the fixed outputs of the bake flags:
+//
+//   ; Comments start with ; or #.
+//   [env_brdf_hq]
+//   table = env_brdf                  ; Defaults to the section name.
+//   path = output/env_brdf_hq.hdr     ; .png, .bmp, .tga or .hdr. Defaults to output/<section>.png.
+//   resolution = 512                  ; Defaults to the table's usual resolution.
+//   samples = 4096                    ; Integration samples, at least 2. Defaults to the table's usual count.
+//   seed = 1                          ; Noise tables only.
+//   channels = rg                     ; Written channels, see below. Defaults to the table's rgba.
+//
+// Channels are a swizzle like rg or r g b, constants 0 and 1, or <table>.<channel> to pack channels of other
+// tables baked at the same resolution, samples and seed, e.g. channels = env_brdf.r env_brdf.g brdf_Fd0.r 1.
+// Perlin noise tables also take period, octaves and gain. Each output must write a different path.
+//
+// Tables are baked once per distinct set of parameters however many outputs use them, and tables that bake
+// together, like the subsurface kernels, are cached together.
+//
+struct ManifestChannel
+{
+    std::string table;  // Empty for a constant.
+    int channel = 0;
+    float value = 0.0f;
+};
+
+struct ManifestOutput
+{
+    std::string name;
+    std::string table;
+    std::string path;
+    int resolution = 0;  // 0 for the table's default.
+    int samples = 0;     // 0 for the table's default.
+    uint32_t seed = 0;
+    int perlinPeriod = 4;
+    int perlinOctaves = 6;
+    float perlinGain = 0.5f;
+    std::vector< ManifestChannel > channels; // Empty for the table's rgba.
+};
+
+// Invalid outputs are reported and left out. Only fails if the file can't be read.
+bool manifest_Load( std::string fileName, std::vector< ManifestOutput >& outputs );
+// Manifest text from anywhere, like manifest_Load. Source names it in reports.
+void manifest_Parse( std::istream& in, std::string source, std::vector< ManifestOutput >& outputs );
+// Every table manifests can bake.
+std::vector< std::string > manifest_TableNames();
+// Fills in defaults, and reports and fails for invalid outputs. Source names where the output came from.
+bool manifest_CheckOutput( std::string source, ManifestOutput& output );
+
+// Receives each output's packed texels instead of writing them to its path, from the output's job. Only the first
+// numChannels channels of each texel are set.
+typedef std::function< void( int output, const std::vector< glm::vec4 >& pixels, int numChannels ) > ManifestSink;
+
+// Keeps baked tables between bake_manifest calls, up to maxTexels texels, so a process baking over and over only
+// bakes the tables whose parameters changed.
+struct ManifestCache;
+ManifestCache* manifest_CreateCache( size_t maxTexels );
+void manifest_DestroyCache( ManifestCache* cache );
+
+// Receives refinements of outputs while the tables they read are baked, every previewSeconds, packed like the
+// sink's texels, with fraction the share of the refining table's texels evaluated so far. Only tables of 2D
+// functions, the BRDF and gloss tables, refine; channels from other tables are 0 in previews. Calls come from
+// worker threads, one at a time.
+typedef std::function< void( int output, const std::vector< glm::vec4 >& pixels, int numChannels, float fraction ) > ManifestPreview;
+
+// Without a sink or preview, outputs are previewed to files as set by baker_setPreviewInterval.
+void bake_manifest( BakeGraph& graph, const std::vector< ManifestOutput >& outputs, ManifestSink sink = nullptr, ManifestCache* cache = nullptr,
+                    ManifestPreview preview = nullptr, double previewSeconds = 0.0 );
@@ -49,9 +49,9 @@ vec4 multiscatterBRDF_retroReflectiveBump( float x, float y )
     return vec4( FdR, FdR, FdR, 1 );
 }
 
-void bake_multiscatterBRDF()
+void bake_multiscatterBRDF( BakeGraph& graph )
 {
-    baker_imageFunction2D( multiscatterBRDF_roughFoundationFunction, 128, "output/brdf_Fd0.png" );
-    baker_imageFunction2D( multiscatterBRDF_disneyDiffuseRough, 128, "output/brdf_Fd1.png" );
-    baker_imageFunction2D( multiscatterBRDF_retroReflectiveBump, 128, "output/brdf_FdR.png" );
+    baker_addJob( graph, "brdf_Fd0", []() { baker_imageFunction2D( multiscatterBRDF_roughFoundationFunction, 128, "output/brdf_Fd0.png" ); } );
+    baker_addJob( graph, "brdf_Fd1", []() { baker_imageFunction2D( multiscatterBRDF_disneyDiffuseRough, 128, "output/brdf_Fd1.png" ); } );
+    baker_addJob( graph, "brdf_FdR", []() { baker_imageFunction2D( multiscatterBRDF_retroReflectiveBump, 128, "output/brdf_FdR.png" ); } );
 }
\ No newline at end of file
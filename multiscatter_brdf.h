@@ -20,4 +20,8 @@
 #pragma once
 #include "common.h"
 
-void bake_multiscatterBRDF();
\ No newline at end of file
+glm::vec4 multiscatterBRDF_roughFoundationFunction( float x, float y );
+glm::vec4 multiscatterBRDF_disneyDiffuseRough( float x, float y );
+glm::vec4 multiscatterBRDF_retroReflectiveBump( float x, float y );
+
+void bake_multiscatterBRDF( BakeGraph& graph );
\ No newline at end of file
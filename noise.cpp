@@ -21,22 +21,645 @@
 #include "noise.h"
 using namespace glm;
 
-#include <random>
+#include <cstdint>
+#include <cfloat>
+#include <cassert>
+#include <chrono>
+#include <climits>
 
-vec4 noisegen_whiteNoise( float x, float y )
+// Implemented here rather than with the other stb libraries, as the row evaluator below shares its tables.
+#define STB_PERLIN_IMPLEMENTATION
+#include <stb/stb_perlin.h>
+
+void noisegen_whiteNoisePixels( int res, uint32_t seed, std::vector< vec4 >& pixels )
+{
+    pixels.resize( res * res );
+    baker_parallelFor( res, [&]( int y ) {
+        for( int x = 0; x < res; x++ ) {
+            pixels[y * res + x] = vec4(
+                baker_random( seed, x, y, 0 ),
+                baker_random( seed, x, y, 1 ),
+                baker_random( seed, x, y, 2 ),
+                1.0f
+            );
+        }
+    } );
+}
+
+void bake_whiteNoise( int res, uint32_t seed, std::string outputFileName )
+{
+    printf( "Baking %dx%d white noise ...\n", res, res );
+    std::vector< vec4 > pixels;
+    noisegen_whiteNoisePixels( res, seed, pixels );
+    baker_writeImage2D( pixels, res, outputFileName );
+}
+
+// Void and cluster blue noise by Ulichney. Energy is a toroidal gaussian splat of every set pixel, truncated
+// to a small window so that toggling a pixel only updates its neighbourhood. The tightest cluster / largest
+// void searches keep the max / min energy per tile and per row of tiles, and only rescan what an update touched.
+//
+// Spatiotemporal blue noise is a stack of slices, each ranked as its own full dither array. A pixel also
+// splats energy onto the same pixel of nearby slices, so each pixel is blue over time as well. Slices take
+// turns setting or clearing one pixel each, which keeps them equally filled.
+//
+// ref: "The void-and-cluster method for dither array generation" by Ulichney
+// ref: "Scalar Spatiotemporal Blue Noise Masks" by Wolfe et. al.
+//
+#define BLUENOISE_SIGMA 1.5f
+#define BLUENOISE_RADIUS 7
+#define BLUENOISE_TILE BLUENOISE_MIN_RES
+#define BLUENOISE_INITIAL_DENSITY 0.1f
+#define BLUENOISE_CHECKPOINT_MAGIC 0x314e4253 // "SBN1"
+#define BLUENOISE_CHECKPOINT_SECONDS 30
+
+struct BlueNoiseState
+{
+    int res;
+    int depth;
+    int tilesPerRow;
+    int temporalRadius;
+    std::vector< float > energy;     // Per slice x pixel.
+    std::vector< uint8_t > bits;     // Per slice x pixel.
+    std::vector< int > wrap;         // Toroidal index for [ -BLUENOISE_RADIUS, res + BLUENOISE_RADIUS ).
+    std::vector< float > kernel;
+
+    std::vector< int > tileCluster;  // Per slice x tile, set pixel with the highest energy, or -1.
+    std::vector< int > tileVoid;     // Per slice x tile, unset pixel with the lowest energy, or -1.
+    std::vector< int > rowCluster;   // Per slice x row of tiles.
+    std::vector< int > rowVoid;      // Per slice x row of tiles.
+};
+
+struct BlueNoiseCheckpointHeader
+{
+    uint32_t magic;
+    int32_t res;
+    int32_t depth;
+    uint32_t seed;
+    int32_t rank;                    // Next rank to assign. Ranks below the initial count are assigned downwards.
+};
+
+int noisegen_blueNoiseMaxEnergy( const BlueNoiseState& s, const int* candidates, int count )
+{
+    int best = -1;
+    for( int i = 0; i < count; i++ ) {
+        int c = candidates[i];
+        if ( c >= 0 && ( best < 0 || s.energy[c] > s.energy[best] ) ) best = c;
+    }
+    return best;
+}
+
+int noisegen_blueNoiseMinEnergy( const BlueNoiseState& s, const int* candidates, int count )
+{
+    int best = -1;
+    for( int i = 0; i < count; i++ ) {
+        int c = candidates[i];
+        if ( c >= 0 && ( best < 0 || s.energy[c] < s.energy[best] ) ) best = c;
+    }
+    return best;
+}
+
+int noisegen_blueNoiseNumTiles( const BlueNoiseState& s )
+{
+    return s.tilesPerRow * s.tilesPerRow;
+}
+
+void noisegen_blueNoiseUpdateTile( BlueNoiseState& s, int z, int tile )
+{
+    int tx = ( tile % s.tilesPerRow ) * BLUENOISE_TILE;
+    int ty = ( tile / s.tilesPerRow ) * BLUENOISE_TILE;
+    int slice = z * s.res * s.res;
+    int cluster = -1, empty = -1;
+    float clusterEnergy = -FLT_MAX, emptyEnergy = FLT_MAX;
+    for( int y = ty; y < min( ty + BLUENOISE_TILE, s.res ); y++ ) {
+        int row = slice + y * s.res;
+        const float* energy = &s.energy[row];
+        const uint8_t* bits = &s.bits[row];
+        for( int x = tx; x < min( tx + BLUENOISE_TILE, s.res ); x++ ) {
+            if ( bits[x] ) {
+                if ( energy[x] > clusterEnergy ) { clusterEnergy = energy[x]; cluster = row + x; }
+            } else {
+                if ( energy[x] < emptyEnergy ) { emptyEnergy = energy[x]; empty = row + x; }
+            }
+        }
+    }
+    s.tileCluster[z * noisegen_blueNoiseNumTiles( s ) + tile] = cluster;
+    s.tileVoid[z * noisegen_blueNoiseNumTiles( s ) + tile] = empty;
+}
+
+void noisegen_blueNoiseUpdateTileRow( BlueNoiseState& s, int z, int ty )
+{
+    int tiles = z * noisegen_blueNoiseNumTiles( s ) + ty * s.tilesPerRow;
+    s.rowCluster[z * s.tilesPerRow + ty] = noisegen_blueNoiseMaxEnergy( s, &s.tileCluster[tiles], s.tilesPerRow );
+    s.rowVoid[z * s.tilesPerRow + ty] = noisegen_blueNoiseMinEnergy( s, &s.tileVoid[tiles], s.tilesPerRow );
+}
+
+void noisegen_blueNoiseInit( BlueNoiseState& s, int res, int depth )
 {
-    static std::random_device s_randomDevice;
-    static std::mt19937 s_mersenneTwisterEngine( s_randomDevice() );
-    static std::uniform_real_distribution< float > s_uniformDist( 0.0f, 1.0f );
-    return vec4(
-        s_uniformDist( s_mersenneTwisterEngine ),
-        s_uniformDist( s_mersenneTwisterEngine ),
-        s_uniformDist( s_mersenneTwisterEngine ),
-        1.0f
-    );
+    s.res = res;
+    s.depth = depth;
+    s.tilesPerRow = ( res + BLUENOISE_TILE - 1 ) / BLUENOISE_TILE;
+    s.temporalRadius = depth > 1 ? clamp( ( depth - 1 ) / 2, 1, BLUENOISE_RADIUS ) : 0;
+    s.energy.assign( depth * res * res, 0.0f );
+    s.bits.assign( depth * res * res, 0 );
+    s.wrap.resize( res + 2 * BLUENOISE_RADIUS );
+    for( int i = 0; i < int( s.wrap.size() ); i++ ) {
+        s.wrap[i] = ( i - BLUENOISE_RADIUS + res * BLUENOISE_RADIUS ) % res;
+    }
+
+    int width = 2 * BLUENOISE_RADIUS + 1;
+    s.kernel.resize( width * width );
+    for( int dy = -BLUENOISE_RADIUS; dy <= BLUENOISE_RADIUS; dy++ ) {
+        for( int dx = -BLUENOISE_RADIUS; dx <= BLUENOISE_RADIUS; dx++ ) {
+            float d2 = float( dx * dx + dy * dy );
+            s.kernel[( dy + BLUENOISE_RADIUS ) * width + dx + BLUENOISE_RADIUS] = exp( -d2 / ( 2.0f * BLUENOISE_SIGMA * BLUENOISE_SIGMA ) );
+        }
+    }
+
+    s.tileCluster.assign( depth * noisegen_blueNoiseNumTiles( s ), -1 );
+    s.tileVoid.assign( depth * noisegen_blueNoiseNumTiles( s ), -1 );
+    s.rowCluster.assign( depth * s.tilesPerRow, -1 );
+    s.rowVoid.assign( depth * s.tilesPerRow, -1 );
+}
+
+void noisegen_blueNoiseUpdateAllTiles( BlueNoiseState& s )
+{
+    baker_parallelFor( s.depth, [&]( int z ) {
+        for( int t = 0; t < noisegen_blueNoiseNumTiles( s ); t++ ) {
+            noisegen_blueNoiseUpdateTile( s, z, t );
+        }
+        for( int ty = 0; ty < s.tilesPerRow; ty++ ) {
+            noisegen_blueNoiseUpdateTileRow( s, z, ty );
+        }
+    } );
+}
+
+// A single pixel's energy went up or down. Its tile only needs a rescan if it was the tile's best candidate
+// and got worse. The row of tiles is refreshed whenever the tile's best or its energy changed, as it compares
+// the energies of the tiles' best candidates.
+//
+void noisegen_blueNoiseUpdatePixel( BlueNoiseState& s, int idx, bool increased )
+{
+    int z = idx / ( s.res * s.res );
+    int x = idx % s.res, y = ( idx / s.res ) % s.res;
+    int ty = y / BLUENOISE_TILE;
+    int tile = ty * s.tilesPerRow + x / BLUENOISE_TILE;
+    int& best = s.bits[idx] ? s.tileCluster[z * noisegen_blueNoiseNumTiles( s ) + tile] : s.tileVoid[z * noisegen_blueNoiseNumTiles( s ) + tile];
+    bool better = s.bits[idx] ? increased : !increased;
+    if ( best == idx ) {
+        if ( !better ) noisegen_blueNoiseUpdateTile( s, z, tile );
+    } else if ( better && ( best < 0 || ( s.bits[idx] ? s.energy[idx] > s.energy[best] : s.energy[idx] < s.energy[best] ) ) ) {
+        best = idx;
+    } else {
+        return;
+    }
+    noisegen_blueNoiseUpdateTileRow( s, z, ty );
+}
+
+// Sets or clears a pixel and splats its energy. Tiles are only refreshed when asked, so the initial pattern
+// can be set up without rescanning.
+//
+void noisegen_blueNoiseToggle( BlueNoiseState& s, int idx, bool updateTiles = true )
+{
+    int sliceSize = s.res * s.res;
+    int z = idx / sliceSize;
+    int px = idx % s.res, py = ( idx / s.res ) % s.res;
+    float sign = s.bits[idx] ? -1.0f : 1.0f;
+    s.bits[idx] = !s.bits[idx];
+
+    int width = 2 * BLUENOISE_RADIUS + 1;
+    for( int dy = 0; dy < width; dy++ ) {
+        float* row = &s.energy[z * sliceSize + s.wrap[py + dy] * s.res];
+        const int* wrapX = &s.wrap[px];
+        const float* k = &s.kernel[dy * width];
+        for( int dx = 0; dx < width; dx++ ) {
+            row[wrapX[dx]] += sign * k[dx];
+        }
+    }
+
+    // Same pixel on nearby slices, using the centre row of the spatial kernel as the temporal falloff. When the
+    // window wraps onto the same slice from both sides, as with 2 slices, that slice is only splatted once.
+    const float* kt = &s.kernel[BLUENOISE_RADIUS * width + BLUENOISE_RADIUS];
+    for( int dz = -s.temporalRadius; dz <= s.temporalRadius; dz++ ) {
+        if ( !dz || -2 * dz == s.depth ) continue;
+        int other = ( ( z + dz + s.depth ) % s.depth ) * sliceSize + py * s.res + px;
+        s.energy[other] += sign * kt[dz];
+        if ( updateTiles ) noisegen_blueNoiseUpdatePixel( s, other, sign > 0.0f );
+    }
+
+    if ( !updateTiles ) return;
+    int tx0 = s.wrap[px] / BLUENOISE_TILE, tx1 = s.wrap[px + width - 1] / BLUENOISE_TILE;
+    int ty0 = s.wrap[py] / BLUENOISE_TILE, ty1 = s.wrap[py + width - 1] / BLUENOISE_TILE;
+    for( int ty = ty0; ; ty = ( ty + 1 ) % s.tilesPerRow ) {
+        for( int tx = tx0; ; tx = ( tx + 1 ) % s.tilesPerRow ) {
+            noisegen_blueNoiseUpdateTile( s, z, ty * s.tilesPerRow + tx );
+            if ( tx == tx1 ) break;
+        }
+        noisegen_blueNoiseUpdateTileRow( s, z, ty );
+        if ( ty == ty1 ) break;
+    }
 }
 
-void bake_noiseTextures()
+// Debug builds check the tile and row caches against a scan of the whole slice.
+//
+void noisegen_blueNoiseCheckExtreme( const BlueNoiseState& s, int z, int result, bool cluster )
 {
-    baker_imageFunction2D( noisegen_whiteNoise, 128, "output/whiteNoise.png" );
-}
\ No newline at end of file
+#ifndef NDEBUG
+    int slice = z * s.res * s.res;
+    int best = -1;
+    for( int i = slice; i < slice + s.res * s.res; i++ ) {
+        if ( bool( s.bits[i] ) != cluster ) continue;
+        if ( best < 0 || ( cluster ? s.energy[i] > s.energy[best] : s.energy[i] < s.energy[best] ) ) best = i;
+    }
+    assert( ( result < 0 ) == ( best < 0 ) );
+    assert( result < 0 || ( bool( s.bits[result] ) == cluster && s.energy[result] == s.energy[best] ) );
+#endif
+}
+
+int noisegen_blueNoiseTightestCluster( const BlueNoiseState& s, int z )
+{
+    int cluster = noisegen_blueNoiseMaxEnergy( s, &s.rowCluster[z * s.tilesPerRow], s.tilesPerRow );
+    noisegen_blueNoiseCheckExtreme( s, z, cluster, true );
+    return cluster;
+}
+
+int noisegen_blueNoiseLargestVoid( const BlueNoiseState& s, int z )
+{
+    int empty = noisegen_blueNoiseMinEnergy( s, &s.rowVoid[z * s.tilesPerRow], s.tilesPerRow );
+    noisegen_blueNoiseCheckExtreme( s, z, empty, false );
+    return empty;
+}
+
+void noisegen_blueNoiseSetBits( BlueNoiseState& s, const std::vector< uint8_t >& bits )
+{
+    std::fill( s.energy.begin(), s.energy.end(), 0.0f );
+    std::fill( s.bits.begin(), s.bits.end(), 0 );
+    for( int i = 0; i < int( bits.size() ); i++ ) {
+        if ( bits[i] ) noisegen_blueNoiseToggle( s, i, false );
+    }
+    noisegen_blueNoiseUpdateAllTiles( s );
+}
+
+bool noisegen_blueNoiseLoadCheckpoint( std::string fileName, BlueNoiseCheckpointHeader& header, std::vector< int >& ranks,
+                                       std::vector< uint8_t >& bits, std::vector< uint8_t >& prototype )
+{
+    FILE* fp = fopen( fileName.c_str(), "rb" );
+    if ( !fp ) return false;
+    BlueNoiseCheckpointHeader h;
+    bool ok = fread( &h, sizeof( h ), 1, fp ) == 1 && h.magic == header.magic && h.res == header.res &&
+              h.depth == header.depth && h.seed == header.seed;
+    ok = ok && fread( ranks.data(), sizeof( int ), ranks.size(), fp ) == ranks.size();
+    ok = ok && fread( bits.data(), 1, bits.size(), fp ) == bits.size();
+    ok = ok && fread( prototype.data(), 1, prototype.size(), fp ) == prototype.size();
+    fclose( fp );
+    if ( ok ) header.rank = h.rank;
+    return ok;
+}
+
+void noisegen_blueNoiseSaveCheckpoint( std::string fileName, const BlueNoiseCheckpointHeader& header, const std::vector< int >& ranks,
+                                       const std::vector< uint8_t >& bits, const std::vector< uint8_t >& prototype )
+{
+    // Written aside and swapped in, so an interrupted save leaves the last checkpoint intact.
+    namespace fs = std::experimental::filesystem;
+    std::string tempFileName = fileName + ".tmp";
+    FILE* fp = fopen( tempFileName.c_str(), "wb" );
+    if ( !fp ) return;
+    fwrite( &header, sizeof( header ), 1, fp );
+    fwrite( ranks.data(), sizeof( int ), ranks.size(), fp );
+    fwrite( bits.data(), 1, bits.size(), fp );
+    fwrite( prototype.data(), 1, prototype.size(), fp );
+    fclose( fp );
+    std::error_code ec;
+    fs::rename( tempFileName, fileName, ec );
+}
+
+// Returns the rank of every pixel of every slice, in [ 0, res * res ) per slice. With energy over all pixels
+// being constant, the tightest cluster of unset pixels is the largest void of set ones, so the second half of
+// the ranking carries on filling voids. An empty checkpoint file name disables checkpointing; otherwise
+// progress is saved periodically, when cancelled and once done, and a matching checkpoint picks up where it
+// left off. The caller removes the checkpoint once its outputs are written.
+//
+std::vector< int > noisegen_blueNoiseRanks( int res, int depth, uint32_t seed, std::string checkpointFileName )
+{
+    BAKER_TRACE_SCOPE( "rank blue noise" );
+    int numPixels = res * res;
+    int numInitial = max( 1, int( numPixels * BLUENOISE_INITIAL_DENSITY ) );
+    BlueNoiseState s;
+    noisegen_blueNoiseInit( s, res, depth );
+
+    std::vector< int > ranks( depth * numPixels );
+    std::vector< uint8_t > prototype( depth * numPixels );
+    BlueNoiseCheckpointHeader header = { BLUENOISE_CHECKPOINT_MAGIC, res, depth, seed, -1 };
+
+    if ( checkpointFileName.size() && noisegen_blueNoiseLoadCheckpoint( checkpointFileName, header, ranks, s.bits, prototype ) ) {
+        printf( "    Resuming %s at rank %d ...\n", checkpointFileName.c_str(), header.rank );
+        noisegen_blueNoiseSetBits( s, std::vector< uint8_t >( s.bits ) );
+    } else {
+        // Random initial pattern per slice, then swap tightest clusters into largest voids until it settles.
+        std::vector< int > order( numPixels );
+        for( int z = 0; z < depth; z++ ) {
+            for( int i = 0; i < numPixels; i++ ) order[i] = i;
+            for( int i = numPixels - 1; i > 0; i-- ) {
+                std::swap( order[i], order[baker_hash( seed, i, z, 0 ) % uint32_t( i + 1 )] );
+            }
+            for( int i = 0; i < numInitial; i++ ) {
+                noisegen_blueNoiseToggle( s, z * numPixels + order[i], false );
+            }
+        }
+        noisegen_blueNoiseUpdateAllTiles( s );
+
+        for( int iter = 0; iter < numPixels; iter++ ) {
+            bool settled = true;
+            for( int z = 0; z < depth; z++ ) {
+                int cluster = noisegen_blueNoiseTightestCluster( s, z );
+                noisegen_blueNoiseToggle( s, cluster );
+                int empty = noisegen_blueNoiseLargestVoid( s, z );
+                noisegen_blueNoiseToggle( s, empty );
+                settled = settled && empty == cluster;
+            }
+            if ( settled ) break;
+        }
+        prototype = s.bits;
+        header.rank = numInitial - 1;
+    }
+
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    auto checkpoint = [&]() {
+        if ( !checkpointFileName.size() ) return;
+        auto now = std::chrono::steady_clock::now();
+        if ( now - lastCheckpoint < std::chrono::seconds( BLUENOISE_CHECKPOINT_SECONDS ) ) return;
+        noisegen_blueNoiseSaveCheckpoint( checkpointFileName, header, ranks, s.bits, prototype );
+        lastCheckpoint = now;
+    };
+
+    // Rank the initial pattern by removing tightest clusters.
+    for( ; header.rank >= 0 && header.rank < numInitial && !baker_cancelled(); header.rank-- ) {
+        checkpoint();
+        for( int z = 0; z < depth; z++ ) {
+            int cluster = noisegen_blueNoiseTightestCluster( s, z );
+            noisegen_blueNoiseToggle( s, cluster );
+            ranks[cluster] = header.rank;
+        }
+    }
+
+    // Rank the rest by filling largest voids.
+    if ( header.rank < numInitial && !baker_cancelled() ) {
+        noisegen_blueNoiseSetBits( s, prototype );
+        header.rank = numInitial;
+    }
+    for( ; header.rank < numPixels && !baker_cancelled(); header.rank++ ) {
+        checkpoint();
+        for( int z = 0; z < depth; z++ ) {
+            int empty = noisegen_blueNoiseLargestVoid( s, z );
+            noisegen_blueNoiseToggle( s, empty );
+            ranks[empty] = header.rank;
+        }
+    }
+
+    if ( checkpointFileName.size() ) {
+        noisegen_blueNoiseSaveCheckpoint( checkpointFileName, header, ranks, s.bits, prototype );
+    }
+    return ranks;
+}
+
+void noisegen_blueNoisePixels( const std::vector< std::vector< int > >& ranks, int res, int z, std::vector< vec4 >& pixels )
+{
+    int numChannels = int( ranks.size() );
+    pixels.assign( res * res, vec4( 0.0f, 0.0f, 0.0f, 1.0f ) );
+    for( int i = 0; i < res * res; i++ ) {
+        for( int c = 0; c < numChannels; c++ ) {
+            pixels[i][c] = ( float( ranks[c][z * res * res + i] ) + 0.5f ) / float( res * res );
+        }
+        if ( numChannels == 1 ) {
+            pixels[i] = vec4( vec3( pixels[i].x ), 1.0f );
+        }
+    }
+}
+
+// Channels are ranked independently, in parallel. Once cancelled, channels that never started have no ranks, and
+// pixels is left blank.
+//
+void noisegen_blueNoiseImage( int res, int numChannels, uint32_t seed, std::vector< vec4 >& pixels )
+{
+    std::vector< std::vector< int > > ranks( numChannels );
+    baker_parallelFor( numChannels, [&]( int c ) {
+        ranks[c] = noisegen_blueNoiseRanks( res, 1, baker_hash( seed, 0, 0, c ), "" );
+    } );
+    if ( baker_cancelled() ) {
+        pixels.assign( res * res, vec4( 0.0f, 0.0f, 0.0f, 1.0f ) );
+        return;
+    }
+    noisegen_blueNoisePixels( ranks, res, 0, pixels );
+}
+
+void bake_blueNoise( int res, int numChannels, uint32_t seed, std::string outputFileName )
+{
+    res = clamp( res, BLUENOISE_MIN_RES, 4096 );
+    numChannels = clamp( numChannels, 1, 4 );
+    printf( "Baking %dx%d blue noise with %d channels ...\n", res, res, numChannels );
+
+    std::vector< vec4 > pixels;
+    noisegen_blueNoiseImage( res, numChannels, seed, pixels );
+    baker_writeImage2D( pixels, res, outputFileName );
+}
+
+// Written as numbered slices, output/<baseName>_NN.png. Long runs checkpoint each channel next to the output,
+// and pick up from there when rerun with the same settings.
+//
+void bake_spatiotemporalBlueNoise( int res, int depth, int numChannels, uint32_t seed, std::string baseName )
+{
+    res = clamp( res, BLUENOISE_MIN_RES, 4096 );
+    numChannels = clamp( numChannels, 1, 4 );
+    printf( "Baking %dx%dx%d spatiotemporal blue noise with %d channels ...\n", res, res, depth, numChannels );
+
+    std::vector< std::vector< int > > ranks( numChannels );
+    std::vector< std::string > checkpointFileNames( numChannels );
+    baker_parallelFor( numChannels, [&]( int c ) {
+        checkpointFileNames[c] = "output/" + baseName + "_" + std::to_string( c ) + ".checkpoint";
+        ranks[c] = noisegen_blueNoiseRanks( res, depth, baker_hash( seed, 0, 0, c ), checkpointFileNames[c] );
+    } );
+    if ( baker_cancelled() ) return;
+
+    std::vector< vec4 > pixels;
+    for( int z = 0; z < depth; z++ ) {
+        char outputFileName[512];
+        snprintf( outputFileName, sizeof( outputFileName ), "output/%s_%02d.png", baseName.c_str(), z );
+        noisegen_blueNoisePixels( ranks, res, z, pixels );
+        baker_writeImage2D( pixels, res, outputFileName );
+    }
+
+    // Only now that every slice is written are the checkpoints done with.
+    if ( baker_cancelled() ) return;
+    for( auto& checkpointFileName : checkpointFileNames ) {
+        std::remove( checkpointFileName.c_str() );
+    }
+}
+
+// Evaluates stb_perlin_noise3_seed at x = x0 + i * dx for a row of samples, dx > 0. With y and z fixed for the
+// row, every corner's gradient dot product is linear in x, and so is the y / z interpolation of each face of
+// the cell. So per cell the lattice lookups reduce to two lines, leaving a short branch-free loop over the
+// cell's samples. Results match stb_perlin up to float rounding.
+//
+void noisegen_perlinRow( float x0, float dx, int count, float y, float z, int xWrap, int yWrap, int zWrap, unsigned char seed, float* out )
+{
+    static const float basis[12][3] = {
+        {  1, 1, 0 }, { -1, 1, 0 }, {  1,-1, 0 }, { -1,-1, 0 },
+        {  1, 0, 1 }, { -1, 0, 1 }, {  1, 0,-1 }, { -1, 0,-1 },
+        {  0, 1, 1 }, {  0,-1, 1 }, {  0, 1,-1 }, {  0,-1,-1 }
+    };
+
+    unsigned int xMask = ( xWrap - 1 ) & 255;
+    unsigned int yMask = ( yWrap - 1 ) & 255;
+    unsigned int zMask = ( zWrap - 1 ) & 255;
+    int py = stb__perlin_fastfloor( y );
+    int pz = stb__perlin_fastfloor( z );
+    int y0 = py & yMask, y1 = ( py + 1 ) & yMask;
+    int z0 = pz & zMask, z1 = ( pz + 1 ) & zMask;
+    y -= py; float v = stb__perlin_ease( y );
+    z -= pz; float w = stb__perlin_ease( z );
+
+    for( int i = 0; i < count; ) {
+        int px = stb__perlin_fastfloor( x0 + float( i ) * dx );
+        int r0 = stb__perlin_randtab[( px & xMask ) + seed];
+        int r1 = stb__perlin_randtab[( ( px + 1 ) & xMask ) + seed];
+        int r[4] = {
+            stb__perlin_randtab[r0 + y0], stb__perlin_randtab[r0 + y1],
+            stb__perlin_randtab[r1 + y0], stb__perlin_randtab[r1 + y1]
+        };
+
+        // Corners in stb order n000, n001, n010, n011, n100, n101, n110, n111, as slope and offset in x.
+        float slope[8], offset[8];
+        for( int c = 0; c < 8; c++ ) {
+            const float* g = basis[stb__perlin_randtab_grad_idx[r[c >> 1] + ( ( c & 1 ) ? z1 : z0 )]];
+            slope[c] = g[0];
+            offset[c] = g[1] * ( ( c & 2 ) ? y - 1 : y ) + g[2] * ( ( c & 1 ) ? z - 1 : z );
+        }
+        float slope0 = stb__perlin_lerp( stb__perlin_lerp( slope[0], slope[1], w ), stb__perlin_lerp( slope[2], slope[3], w ), v );
+        float slope1 = stb__perlin_lerp( stb__perlin_lerp( slope[4], slope[5], w ), stb__perlin_lerp( slope[6], slope[7], w ), v );
+        float offset0 = stb__perlin_lerp( stb__perlin_lerp( offset[0], offset[1], w ), stb__perlin_lerp( offset[2], offset[3], w ), v );
+        float offset1 = stb__perlin_lerp( stb__perlin_lerp( offset[4], offset[5], w ), stb__perlin_lerp( offset[6], offset[7], w ), v );
+
+        int end = i + 1;
+        while ( end < count && stb__perlin_fastfloor( x0 + float( end ) * dx ) == px ) end++;
+        for( ; i < end; i++ ) {
+            float x = x0 + float( i ) * dx - float( px );
+            float u = stb__perlin_ease( x );
+            out[i] = stb__perlin_lerp( slope0 * x + offset0, slope1 * ( x - 1 ) + offset1, u );
+        }
+    }
+}
+
+// Fractal sums over octaves of lacunarity 2, each wrapping at its own frequency so the sum still tiles. Octave
+// seeds and the ridged / turbulence terms follow stb_perlin's fractal functions, with a ridge offset of 1. Samples
+// sit at texel centres, which keeps the finest octaves from landing on lattice points where noise is zero.
+// Results are remapped to [ 0, 1 ] by the total amplitude.
+//
+void noisegen_perlinFractalRow( PerlinNoiseType type, const NoiseSettings& settings, int res, int y, int z, float* out )
+{
+    std::vector< float > octave( res ), prev( res, 1.0f );
+    std::fill( out, out + res, 0.0f );
+
+    int octaves = type == PERLIN_NOISE ? 1 : max( settings.perlinOctaves, 1 );
+    float amplitude = type == PERLIN_NOISE_RIDGED ? 0.5f : 1.0f;
+    float totalAmplitude = 0.0f;
+    for( int o = 0; o < octaves; o++ ) {
+        int period = settings.perlinPeriod << o;
+        float scale = float( period ) / float( res );
+        unsigned char seed = ( unsigned char )( settings.seed + o );
+        noisegen_perlinRow( 0.5f * scale, scale, res, ( float( y ) + 0.5f ) * scale, ( float( z ) + 0.5f ) * scale, period, period, period, seed, octave.data() );
+
+        for( int i = 0; i < res; i++ ) {
+            if ( type == PERLIN_NOISE_RIDGED ) {
+                float r = 1.0f - abs( octave[i] );
+                r = r * r;
+                out[i] += r * amplitude * prev[i];
+                prev[i] = r;
+            } else if ( type == PERLIN_NOISE_TURBULENCE ) {
+                out[i] += abs( octave[i] ) * amplitude;
+            } else {
+                out[i] += octave[i] * amplitude;
+            }
+        }
+        totalAmplitude += amplitude;
+        amplitude *= settings.perlinGain;
+    }
+
+    bool isSigned = type == PERLIN_NOISE || type == PERLIN_NOISE_FBM;
+    for( int i = 0; i < res; i++ ) {
+        out[i] = isSigned ? out[i] / totalAmplitude * 0.5f + 0.5f : out[i] / totalAmplitude;
+    }
+}
+
+bool noisegen_parsePerlinType( std::string name, PerlinNoiseType& type )
+{
+    if ( name == "perlin" ) {
+        type = PERLIN_NOISE;
+    } else if ( name == "fbm" ) {
+        type = PERLIN_NOISE_FBM;
+    } else if ( name == "ridged" ) {
+        type = PERLIN_NOISE_RIDGED;
+    } else if ( name == "turbulence" ) {
+        type = PERLIN_NOISE_TURBULENCE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void noisegen_perlinImage( PerlinNoiseType type, const NoiseSettings& settings, int res, int z, std::vector< vec4 >& pixels )
+{
+    pixels.resize( res * res );
+    baker_parallelFor( res, [&]( int y ) {
+        std::vector< float > row( res );
+        noisegen_perlinFractalRow( type, settings, res, y, z, row.data() );
+        for( int x = 0; x < res; x++ ) {
+            pixels[y * res + x] = vec4( vec3( row[x] ), 1.0f );
+        }
+    } );
+}
+
+// Volumes are streamed out as numbered slices, each baked in parallel over rows and written before the next,
+// so only one slice is ever held in memory.
+//
+// One job per noise type.
+//
+void bake_perlinNoise( BakeGraph& graph, const NoiseSettings& settings )
+{
+    int res = max( settings.perlinRes, 1 );
+    int depth = settings.perlinVolume ? res : 1;
+    for( auto& name : settings.perlinTypes ) {
+        PerlinNoiseType type;
+        if ( !noisegen_parsePerlinType( name, type ) ) {
+            printf( "Unknown perlin noise type %s, skipping.\n", name.c_str() );
+            continue;
+        }
+
+        baker_addJob( graph, name + "Noise", [=]() {
+            printf( "Baking %dx%dx%d tileable %s noise ...\n", res, res, depth, name.c_str() );
+            std::vector< vec4 > pixels;
+            for( int z = 0; z < depth; z++ ) {
+                noisegen_perlinImage( type, settings, res, z, pixels );
+
+                char outputFileName[512];
+                if ( settings.perlinVolume ) {
+                    snprintf( outputFileName, sizeof( outputFileName ), "output/%sNoise_%03d.png", name.c_str(), z );
+                } else {
+                    snprintf( outputFileName, sizeof( outputFileName ), "output/%sNoise.png", name.c_str() );
+                }
+                baker_writeImage2D( pixels, res, outputFileName );
+            }
+        } );
+    }
+}
+
+void bake_noiseTextures( BakeGraph& graph, const NoiseSettings& settings )
+{
+    baker_addJob( graph, "whiteNoise", [=]() { bake_whiteNoise( 128, settings.seed, "output/whiteNoise.png" ); } );
+    baker_addJob( graph, "blueNoise", [=]() {
+        bake_blueNoise( settings.blueNoiseRes, settings.blueNoiseChannels, settings.seed, "output/blueNoise.png" );
+    } );
+    if ( settings.blueNoiseSlices > 0 ) {
+        baker_addJob( graph, "spatiotemporalBlueNoise", [=]() {
+            bake_spatiotemporalBlueNoise( settings.blueNoiseRes, settings.blueNoiseSlices, settings.blueNoiseChannels, settings.seed, "spatiotemporalBlueNoise" );
+        } );
+    }
+}
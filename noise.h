@@ -20,4 +20,37 @@
 #pragma once
 #include "common.h"
 
-void bake_noiseTextures();
\ No newline at end of file
+#define BLUENOISE_MIN_RES 16
+
+enum PerlinNoiseType
+{
+    PERLIN_NOISE,
+    PERLIN_NOISE_FBM,
+    PERLIN_NOISE_RIDGED,
+    PERLIN_NOISE_TURBULENCE
+};
+
+struct NoiseSettings
+{
+    uint32_t seed = 0;
+    int blueNoiseRes = 128;
+    int blueNoiseChannels = 1;
+    int blueNoiseSlices = 0; // Spatiotemporal blue noise slices, 0 to skip.
+
+    std::vector< std::string > perlinTypes; // perlin, fbm, ridged or turbulence.
+    int perlinRes = 256;
+    int perlinPeriod = 4; // Lattice cells across the texture at the first octave, must be a power of two.
+    int perlinOctaves = 6;
+    float perlinGain = 0.5f;
+    bool perlinVolume = false; // Bake res^3 volumes instead of 2D textures.
+};
+
+void noisegen_whiteNoisePixels( int res, uint32_t seed, std::vector< glm::vec4 >& pixels );
+// res in [ BLUENOISE_MIN_RES, 4096 ], numChannels in [ 1, 4 ]. A single channel is replicated to rgb.
+void noisegen_blueNoiseImage( int res, int numChannels, uint32_t seed, std::vector< glm::vec4 >& pixels );
+bool noisegen_parsePerlinType( std::string name, PerlinNoiseType& type );
+// Slice z of the tileable noise, using the seed and perlin settings.
+void noisegen_perlinImage( PerlinNoiseType type, const NoiseSettings& settings, int res, int z, std::vector< glm::vec4 >& pixels );
+
+void bake_noiseTextures( BakeGraph& graph, const NoiseSettings& settings );
+void bake_perlinNoise( BakeGraph& graph, const NoiseSettings& settings );
\ No newline at end of file
@@ -17,6 +17,10 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include <optim.hpp>
-#include <optim/src/unconstrained/nm.cpp>
+#include "optim.h"
 
+#include <optim/src/line_search/more_thuente.cpp>
+#include <optim/src/unconstrained/nm.cpp>
+#include <optim/src/unconstrained/de.cpp>
+#include <optim/src/unconstrained/lbfgs.cpp>
+#include <optim/src/unconstrained/pso.cpp>
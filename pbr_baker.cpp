@@ -17,16 +17,21 @@
     CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include "common.h"
+#include "libpbrbaker.h"
 #include "env_brdf.h"
 #include "multiscatter_brdf.h"
 #include "gloss_normal.h"
 #include "blackbody.h"
 #include "subsurface.h"
 #include "noise.h"
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb/stb_image_write.h>
+#include "spectrum.h"
+#include "fit.h"
+#include "sampling.h"
+#include "bench.h"
+#include "manifest.h"
+#include "convergence.h"
+#include "server.h"
+#include "verify.h"
 
 #include <cxxopts/include/cxxopts.hpp>
 
@@ -42,51 +47,6 @@ vec4 baker_testFunctionXY( float x, float y )
     return vec4( x, y, 0, 1.0f );
 }
 
-void baker_imageFunction2D( std::function< vec4( float x, float y ) > func, int res, std::string outputFileName )
-{
-    std::vector< vec4 > pixels;
-    pixels.resize( res * res );
-    
-    printf( "Baking 2D image table %s ...\n", outputFileName.c_str() );
-    for( int i = 0; i < res; i++ ) {
-        for( int j = 0; j < res; j++ ) {
-            float x = float( i ) / ( res - 1 );
-            float y = float( j ) / ( res - 1 );
-            pixels[i * res + j] = func( x, y );
-        }
-    }
-
-    printf( "    Converting %s to uint8 ...\n", outputFileName.c_str() );
-    std::vector< u8vec4 > pixels_u8;
-    pixels_u8.resize( res * res );
-    for( int i = 0; i < res; i++ ) {
-        for( int j = 0; j < res; j++ ) {
-            pixels_u8[i * res + j] = glm::clamp( pixels[i * res + j], vec4( 0.0f ), vec4( 1.0f ) ) * 255.0f;
-        }
-    }
-    
-    namespace fs = std::experimental::filesystem;
-    auto ext = fs::path( outputFileName ).extension().u8string();
-    
-    printf( "    Writing %s ...\n", outputFileName.c_str() );
-    if ( ext == ".png" ) {
-        auto result = stbi_write_png( outputFileName.c_str(), res, res, 4, pixels_u8.data(), res * sizeof( u8vec4 ) );
-        assert( result );
-    } else if ( ext == ".bmp" ) {
-        auto result = stbi_write_bmp( outputFileName.c_str(), res, res, 4, pixels_u8.data() );
-        assert( result );
-    } else if ( ext == ".tga" ) {
-        auto result = stbi_write_tga( outputFileName.c_str(), res, res, 4, pixels_u8.data() );
-        assert( result );
-    } else if ( ext == ".hdr" ) {
-        auto result = stbi_write_hdr( outputFileName.c_str(), res, res, 4, reinterpret_cast< float* >( pixels.data() ) );
-        assert( result );
-    } else {
-        assert( !" Unknown file format!" );
-    }
-    printf( "    Output to %s OK.\n\n", outputFileName.c_str() );
-}
-
 int main( int argc, char *argv[] )
 {
     cxxopts::Options options( "pbr_baker", "Simple open source multi-functional baking tool for PBR material related work." );
@@ -95,9 +55,64 @@ int main( int argc, char *argv[] )
         ( "m,multiscatter_brdf", "Bake multi-scatter BRDF components.", cxxopts::value< bool >() )
         ( "e,env_brdf", "Bake GGX NDF - environment BRDF table.", cxxopts::value< bool >() )
         ( "n,noise", "Output some noise textures.", cxxopts::value< bool >() )
+        ( "seed", "Random seed for noise textures and sample scrambling.", cxxopts::value< uint32_t >()->default_value( "0" ) )
+        ( "blue_res", "Blue noise texture resolution.", cxxopts::value< int >()->default_value( "128" ) )
+        ( "blue_channels", "Number of independent blue noise channels, 1 to 4.", cxxopts::value< int >()->default_value( "1" ) )
+        ( "blue_slices", "Number of spatiotemporal blue noise slices, 0 to skip.", cxxopts::value< int >()->default_value( "0" ) )
+        ( "perlin", "Bake tileable noise of the given types: perlin, fbm, ridged or turbulence.", cxxopts::value< std::vector< std::string > >() )
+        ( "perlin_res", "Tileable noise resolution.", cxxopts::value< int >()->default_value( "256" ) )
+        ( "perlin_period", "Tileable noise lattice cells across the texture, a power of two.", cxxopts::value< int >()->default_value( "4" ) )
+        ( "perlin_volume", "Bake tileable noise as res^3 volume slices.", cxxopts::value< bool >() )
+        ( "octaves", "Octaves of fractal tileable noise.", cxxopts::value< int >()->default_value( "6" ) )
+        ( "gain", "Amplitude gain per octave of fractal tileable noise.", cxxopts::value< float >()->default_value( "0.5" ) )
+        ( "samples", "Bake low-discrepancy sample tables: sobol, owen, r2 or hammersley.", cxxopts::value< std::vector< std::string > >() )
+        ( "sample_count", "Number of samples per table.", cxxopts::value< int >()->default_value( "1024" ) )
+        ( "sample_dims", "Number of dimensions per sample.", cxxopts::value< int >()->default_value( "2" ) )
+        ( "sample_format", "Sample table format: float or uint ( 32-bit fixed point ).", cxxopts::value< std::string >()->default_value( "float" ) )
+        ( "scramble_tiles", "Bake per-pixel scrambling and ranking keys that distribute sample error as blue noise.", cxxopts::value< bool >() )
+        ( "scramble_res", "Scrambling key tile resolution.", cxxopts::value< int >()->default_value( "128" ) )
+        ( "scramble_spp", "Samples per pixel of scrambling key tiles, a power of two.", cxxopts::value< int >()->default_value( "16" ) )
+        ( "scramble_dims", "Number of dimensions of scrambling key tiles, optimized in pairs.", cxxopts::value< int >()->default_value( "8" ) )
+        ( "scramble_pass", "Optimization passes over scrambling key tiles, each trying a swap per pixel.", cxxopts::value< int >()->default_value( "16" ) )
         ( "b,blackbody", "Bake black body radiation lookup table and .", cxxopts::value< bool >() )
         ( "g,gloss_normal", "Bake gloss average normal table and gloss blend table.", cxxopts::value< bool >() )
         ( "s,subsurface", "Bake subsurface scattering lookup textures.", cxxopts::value< bool >() )
+        ( "sss_profile", "Bake subsurface lookup textures for radial diffusion profiles from CSV files.", cxxopts::value< std::vector< std::string > >() )
+        ( "sss_distance", "Burley scattering distance in mm per channel.", cxxopts::value< std::vector< float > >()->default_value( "0.7,0.27,0.14" ) )
+        ( "sss_curvature", "Max curvature in 1 / mm of diffusion profile tables.", cxxopts::value< float >()->default_value( "0.5" ) )
+        ( "sss_slices", "Number of scattering distance slices of diffusion profile tables.", cxxopts::value< int >()->default_value( "8" ) )
+        ( "l,spectra", "Bake colour table for measured emission spectra from CSV files.", cxxopts::value< std::vector< std::string > >() )
+        ( "colorspace", "Working colour space for spectra: srgb, rec2020 or acescg.", cxxopts::value< std::string >()->default_value( "srgb" ) )
+        ( "f,fit", "Fit polynomial / rational approximations to baked tables ( .png / .hdr / .csv ) and emit C++ / HLSL / GLSL.", cxxopts::value< std::vector< std::string > >() )
+        ( "fit_form", "Fit form: polynomial or rational.", cxxopts::value< std::string >()->default_value( "polynomial" ) )
+        ( "fit_degree", "Fit degree in x,y.", cxxopts::value< std::vector< int > >()->default_value( "2,5" ) )
+        ( "fit_solver", "Nonlinear refinement for rational fits: none, nm, de, pso or lbfgs.", cxxopts::value< std::string >()->default_value( "nm" ) )
+        ( "fit_starts", "Number of independent solver starts, run in parallel.", cxxopts::value< int >()->default_value( "1" ) )
+        ( "fit_pieces", "Number of uniform pieces along x.", cxxopts::value< int >()->default_value( "1" ) )
+        ( "fit_search", "Search all forms, degrees and piece counts up to the given ones and output the cost / error Pareto frontier.", cxxopts::value< bool >() )
+        ( "fit_budget", "Max error budget to pick the cheapest fit for when searching.", cxxopts::value< double >()->default_value( "0" ) )
+        ( "bench", "Benchmark bakes across thread counts: env_brdf, gloss_normal, blackbody, subsurface, noise, multiscatter_brdf or all.", cxxopts::value< std::vector< std::string > >() )
+        ( "bench_threads", "Thread counts to benchmark, powers of two up to the hardware thread count by default.", cxxopts::value< std::vector< int > >() )
+        ( "bench_repeat", "Runs per thread count, the fastest is reported.", cxxopts::value< int >()->default_value( "3" ) )
+        ( "bench_out", "Benchmark JSON report file.", cxxopts::value< std::string >()->default_value( "output/bench.json" ) )
+        ( "mc_error", "Estimate the error of Monte Carlo tables over sample counts: env_brdf, env_brdf_multiscatter, gloss_normal_length or all.", cxxopts::value< std::vector< std::string > >() )
+        ( "mc_samples", "Sample counts to estimate the error at.", cxxopts::value< std::vector< int > >()->default_value( "64,256,1024,4096" ) )
+        ( "mc_scrambles", "Independently scrambled bakes the error is estimated from.", cxxopts::value< int >()->default_value( "8" ) )
+        ( "mc_res", "Resolution of 2D tables for error estimates.", cxxopts::value< int >()->default_value( "64" ) )
+        ( "manifest", "Bake the outputs listed in INI manifest files, see README.", cxxopts::value< std::vector< std::string > >() )
+        ( "serve", "Serve bake requests over stdin / stdout, keeping baked tables between them, see server.h.", cxxopts::value< bool >() )
+        ( "serve_tile", "Tile size results are streamed back in.", cxxopts::value< int >()->default_value( "64" ) )
+        ( "serve_refine", "Seconds between refined tiles of BRDF and gloss outputs while they bake, 0 for final outputs only.", cxxopts::value< double >()->default_value( "0.5" ) )
+        ( "preview", "Bake 2D tables, also in manifests, coarse to fine, updating <output>.preview images every given seconds until done.", cxxopts::value< double >()->default_value( "0" ) )
+        ( "verify", "Compare every table, baked small, against the float references; exits with 1 on regressions.", cxxopts::value< bool >() )
+        ( "verify_dir", "Directory of the references for --verify.", cxxopts::value< std::string >()->default_value( "reference" ) )
+        ( "verify_update", "Write the references for --verify instead of comparing.", cxxopts::value< bool >() )
+        ( "verify_res", "Resolution tables are verified at.", cxxopts::value< int >()->default_value( "32" ) )
+        ( "verify_lsb", "Max 8-bit difference before a table regresses.", cxxopts::value< int >()->default_value( "1" ) )
+        ( "verify_abs", "Max absolute float difference before a table regresses.", cxxopts::value< float >()->default_value( "0.001" ) )
+        ( "verify_double", "Bake the --verify tables with the integrators summing in double precision.", cxxopts::value< bool >() )
+        ( "trace", "Write a Chrome trace JSON timeline of the bake to the given file.", cxxopts::value< std::string >() )
+        ( "threads", "Number of worker threads, 0 for all hardware threads.", cxxopts::value< int >()->default_value( "0" ) )
         ( "t,test", "Test random functionality.", cxxopts::value< bool >() )
         ( "h,help", "Display help", cxxopts::value< bool >() )
         ;
@@ -112,30 +127,175 @@ int main( int argc, char *argv[] )
         return 0;
     }
 
+    // Benchmarking runs bakes on its own terms, so it replaces the rest of the command line.
+    if( result.count( "bench" ) ) {
+        BenchSettings benchSettings;
+        benchSettings.bakes = result["bench"].as< std::vector< std::string > >();
+        if( result.count( "bench_threads" ) )
+            benchSettings.threadCounts = result["bench_threads"].as< std::vector< int > >();
+        benchSettings.repeats = result["bench_repeat"].as< int >();
+        benchSettings.outputFileName = result["bench_out"].as< std::string >();
+        bake_benchmark( benchSettings );
+        return 0;
+    }
+
+    // Likewise serving, which bakes what it is sent until stdin closes.
+    if( result["serve"].as< bool >() ) {
+        ServeSettings serveSettings;
+        serveSettings.numThreads = result["threads"].as< int >();
+        serveSettings.tileSize = result["serve_tile"].as< int >();
+        serveSettings.refineSeconds = result["serve_refine"].as< double >();
+        bake_serve( serveSettings );
+        return 0;
+    }
+
+    if( result["verify"].as< bool >() || result["verify_update"].as< bool >() ) {
+        VerifySettings verifySettings;
+        verifySettings.referenceDir = result["verify_dir"].as< std::string >();
+        verifySettings.update = result["verify_update"].as< bool >();
+        verifySettings.resolution = result["verify_res"].as< int >();
+        verifySettings.lsbTolerance = result["verify_lsb"].as< int >();
+        verifySettings.absTolerance = result["verify_abs"].as< float >();
+        verifySettings.numThreads = result["threads"].as< int >();
+        verifySettings.referenceSums = result["verify_double"].as< bool >();
+        return bake_verify( verifySettings ) ? 0 : 1;
+    }
+
+    baker_setPreviewInterval( result["preview"].as< double >() );
+
+    // Bakes add their outputs as jobs, and the whole graph runs at once through the library, so independent bakes
+    // share the machine.
+    BakeGraph graph;
+
     if( result["multiscatter_brdf"].as< bool >() )
-        bake_multiscatterBRDF();
+        bake_multiscatterBRDF( graph );
     
     if( result["env_brdf"].as< bool >() )
-        bake_envBRDF();
+        bake_envBRDF( graph );
+
+    NoiseSettings noiseSettings;
+    noiseSettings.seed = result["seed"].as< uint32_t >();
+    noiseSettings.blueNoiseRes = result["blue_res"].as< int >();
+    noiseSettings.blueNoiseChannels = result["blue_channels"].as< int >();
+    noiseSettings.blueNoiseSlices = result["blue_slices"].as< int >();
+    noiseSettings.perlinRes = result["perlin_res"].as< int >();
+    noiseSettings.perlinPeriod = result["perlin_period"].as< int >();
+    noiseSettings.perlinOctaves = result["octaves"].as< int >();
+    noiseSettings.perlinGain = result["gain"].as< float >();
+    noiseSettings.perlinVolume = result["perlin_volume"].as< bool >();
 
     if( result["noise"].as< bool >() )
-        bake_noiseTextures();
+        bake_noiseTextures( graph, noiseSettings );
+
+    if( result.count( "perlin" ) ) {
+        noiseSettings.perlinTypes = result["perlin"].as< std::vector< std::string > >();
+        bake_perlinNoise( graph, noiseSettings );
+    }
+
+    if( result.count( "samples" ) ) {
+        bake_sampleSequences( graph, result["samples"].as< std::vector< std::string > >(), result["sample_count"].as< int >(),
+                              result["sample_dims"].as< int >(), noiseSettings.seed, result["sample_format"].as< std::string >() == "uint" );
+    }
+
+    if( result["scramble_tiles"].as< bool >() ) {
+        SampleTileSettings tileSettings;
+        tileSettings.seed = noiseSettings.seed;
+        tileSettings.res = result["scramble_res"].as< int >();
+        tileSettings.samplesPerPixel = result["scramble_spp"].as< int >();
+        tileSettings.numDims = result["scramble_dims"].as< int >();
+        tileSettings.iterations = result["scramble_pass"].as< int >();
+        bake_sampleScramblingTiles( graph, tileSettings );
+    }
 
     if( result["blackbody"].as< bool >() )
-        bake_blackBody();
+        bake_blackBody( graph );
     
     if( result["gloss_normal"].as< bool >() )
-        bake_glossNormalTable();
+        bake_glossNormalTable( graph );
+
+    PssProfileSettings sssSettings;
+    auto sssDistance = result["sss_distance"].as< std::vector< float > >();
+    for( int i = 0; i < 3; i++ ) {
+        sssSettings.scatterDistance[i] = sssDistance.size() ? sssDistance[glm::min( i, int( sssDistance.size() ) - 1 )] : 1.0f;
+    }
+    sssSettings.maxCurvature = result["sss_curvature"].as< float >();
+    sssSettings.numSlices = result["sss_slices"].as< int >();
 
     if( result["subsurface"].as< bool >() )
-        bake_subsurface();
+        bake_subsurface( graph, sssSettings );
+
+    if( result.count( "sss_profile" ) )
+        bake_subsurfaceProfiles( graph, result["sss_profile"].as< std::vector< std::string > >(), sssSettings );
+
+    if( result.count( "spectra" ) ) {
+        SpectrumColorSpace colorSpace;
+        if ( !spectrum_ParseColorSpace( result["colorspace"].as< std::string >(), colorSpace ) ) {
+            printf( "Unknown colour space %s.\n", result["colorspace"].as< std::string >().c_str() );
+            return 1;
+        }
+        bake_emissionSpectra( graph, result["spectra"].as< std::vector< std::string > >(), colorSpace );
+    }
+
+    if( result.count( "mc_error" ) ) {
+        ConvergenceSettings settings;
+        settings.tables = result["mc_error"].as< std::vector< std::string > >();
+        settings.sampleCounts = result["mc_samples"].as< std::vector< int > >();
+        settings.numScrambles = result["mc_scrambles"].as< int >();
+        settings.res = result["mc_res"].as< int >();
+        settings.seed = result["seed"].as< uint32_t >();
+        bake_convergence( graph, settings );
+    }
+
+    if( result.count( "manifest" ) ) {
+        for( auto& fileName : result["manifest"].as< std::vector< std::string > >() ) {
+            std::vector< ManifestOutput > outputs;
+            if ( !manifest_Load( fileName, outputs ) ) {
+                printf( "Could not read manifest %s.\n", fileName.c_str() );
+                return 1;
+            }
+            bake_manifest( graph, outputs );
+        }
+    }
+
+    // Fit after every other job so freshly baked tables from this run are picked up.
+    if( result.count( "fit" ) ) {
+        FitSettings settings;
+        auto degree = result["fit_degree"].as< std::vector< int > >();
+        settings.degreeX = degree.size() > 0 ? degree[0] : 0;
+        settings.degreeY = degree.size() > 1 ? degree[1] : 0;
+        settings.numStarts = result["fit_starts"].as< int >();
+        settings.numPieces = result["fit_pieces"].as< int >();
+        if ( !fit_ParseForm( result["fit_form"].as< std::string >(), settings.form ) ||
+             !fit_ParseSolver( result["fit_solver"].as< std::string >(), settings.solver ) ) {
+            printf( "Unknown fit form or solver.\n" );
+            return 1;
+        }
+        std::vector< int > bakeJobs( graph.jobs.size() );
+        for( int j = 0; j < int( bakeJobs.size() ); j++ ) bakeJobs[j] = j;
+        bool search = result["fit_search"].as< bool >();
+        double budget = result["fit_budget"].as< double >();
+        for( auto& fileName : result["fit"].as< std::vector< std::string > >() ) {
+            baker_addJob( graph, "fit " + fileName, [=]() {
+                if ( search ) {
+                    bake_fitSearch( fileName, settings, budget );
+                } else {
+                    bake_fitTable( fileName, settings );
+                }
+            }, bakeJobs );
+        }
+    }
 
     if( result["test"].as< bool >() )
     {
-        baker_imageFunction2D( baker_testFunction, 64, "output/test_output.png" );
-        baker_imageFunction2D( baker_testFunctionXY, 256, "output/test_outputXY.png" );
+        baker_addJob( graph, "test_output", []() { baker_imageFunction2D( baker_testFunction, 64, "output/test_output.png" ); } );
+        baker_addJob( graph, "test_outputXY", []() { baker_imageFunction2D( baker_testFunctionXY, 256, "output/test_outputXY.png" ); } );
     }
 
+    auto baker = pbrbaker_Create( result["threads"].as< int >() );
+    if ( result.count( "trace" ) ) baker_startTrace();
+    pbrbaker_RunGraph( baker, graph );
+    if ( result.count( "trace" ) ) baker_stopTrace( result["trace"].as< std::string >() );
+    pbrbaker_Destroy( baker );
     return 0;
 }
 
@@ -0,0 +1,681 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "sampling.h"
+using namespace glm;
+
+#include <chrono>
+
+#define SAMPLING_BLOCK_SIZE 4096
+
+// Top 24 bits only, so the result stays below 1.
+float sampling_ToFloat( uint32_t x )
+{
+    return float( x >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+uint32_t sampling_FromDouble( double x )
+{
+    return uint32_t( min( x * 4294967296.0, 4294967295.0 ) );
+}
+
+// Base 2 is a bit reversal; other bases walk the digits.
+//
+uint32_t sampling_RadicalInverse( uint32_t i, uint32_t base )
+{
+    if ( base == 2 ) {
+        return sampling_ReverseBits( i );
+    }
+    double invBase = 1.0 / double( base ), scale = invBase, r = 0.0;
+    for( ; i; i /= base ) {
+        r += double( i % base ) * scale;
+        scale *= invBase;
+    }
+    return sampling_FromDouble( r );
+}
+
+// Joe and Kuo direction numbers: degree s and coefficients a of the primitive polynomial, then the initial m_k.
+// The first dimension is the van der Corput sequence.
+//
+// ref: "Constructing Sobol sequences with better two-dimensional projections" by Joe and Kuo
+//
+static const uint32_t s_sobolPolynomials[SAMPLING_SOBOL_MAX_DIMS - 1][9] = {
+    { 1,  0, 1 },
+    { 2,  1, 1, 3 },
+    { 3,  1, 1, 3, 1 },
+    { 3,  2, 1, 1, 1 },
+    { 4,  1, 1, 1, 3, 3 },
+    { 4,  4, 1, 3, 5, 13 },
+    { 5,  2, 1, 1, 5, 5, 17 },
+    { 5,  4, 1, 1, 5, 5, 5 },
+    { 5,  7, 1, 1, 7, 11, 19 },
+    { 5, 11, 1, 1, 5, 1, 1 },
+    { 5, 13, 1, 1, 1, 3, 11 },
+    { 5, 14, 1, 3, 5, 5, 31 },
+    { 6,  1, 1, 3, 3, 9, 7, 49 },
+    { 6, 13, 1, 1, 1, 15, 21, 21 },
+    { 6, 16, 1, 3, 1, 13, 27, 49 },
+    { 6, 19, 1, 1, 1, 15, 7, 5 },
+    { 6, 22, 1, 3, 1, 15, 13, 25 },
+    { 6, 25, 1, 1, 5, 5, 19, 61 },
+    { 7,  1, 1, 3, 7, 11, 23, 15, 103 },
+    { 7,  4, 1, 3, 7, 13, 13, 15, 69 }
+};
+
+struct SobolDirections
+{
+    uint32_t v[SAMPLING_SOBOL_MAX_DIMS][32];
+
+    SobolDirections()
+    {
+        for( int k = 0; k < 32; k++ ) {
+            v[0][k] = 1u << ( 31 - k );
+        }
+        for( int d = 1; d < SAMPLING_SOBOL_MAX_DIMS; d++ ) {
+            const uint32_t* p = s_sobolPolynomials[d - 1];
+            uint32_t s = p[0], a = p[1];
+            for( uint32_t k = 0; k < 32; k++ ) {
+                if ( k < s ) {
+                    v[d][k] = p[2 + k] << ( 31 - k );
+                    continue;
+                }
+                v[d][k] = v[d][k - s] ^ ( v[d][k - s] >> s );
+                for( uint32_t j = 1; j < s; j++ ) {
+                    if ( ( a >> ( s - 1 - j ) ) & 1 ) v[d][k] ^= v[d][k - j];
+                }
+            }
+        }
+    }
+};
+
+static const SobolDirections& sampling_SobolDirections()
+{
+    static SobolDirections s_directions;
+    return s_directions;
+}
+
+uint32_t sampling_Sobol( uint32_t i, int dim )
+{
+    const uint32_t* v = sampling_SobolDirections().v[dim];
+    uint32_t x = 0;
+    for( int k = 0; i; i >>= 1, k++ ) {
+        if ( i & 1 ) x ^= v[k];
+    }
+    return x;
+}
+
+// Hash based nested uniform scrambling, equivalent to Owen scrambling.
+//
+// ref: "Practical Hash-based Owen Scrambling" by Burley
+//
+uint32_t sampling_OwenScramble( uint32_t x, uint32_t seed )
+{
+    x = sampling_ReverseBits( x );
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return sampling_ReverseBits( x );
+}
+
+// The index is scrambled as well, which decorrelates dimensions while every power of two prefix stays a net.
+uint32_t sampling_SobolOwen( uint32_t i, int dim, uint32_t seed )
+{
+    uint32_t index = sampling_OwenScramble( i, baker_hash( seed ) );
+    return sampling_OwenScramble( sampling_Sobol( index, dim ), baker_hash( seed, 0, 0, dim + 1 ) );
+}
+
+// Roberts' generalised golden ratio sequence, R2 in two dimensions. phi is the root of x^( d + 1 ) = x + 1.
+//
+// ref: http://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/
+//
+double sampling_R2Alpha( int dim, int numDims )
+{
+    double phi = 2.0;
+    for( int iter = 0; iter < 30; iter++ ) {
+        phi = pow( 1.0 + phi, 1.0 / double( numDims + 1 ) );
+    }
+    return fmod( pow( 1.0 / phi, double( dim + 1 ) ), 1.0 );
+}
+
+uint32_t sampling_R2( uint32_t i, double alpha )
+{
+    double x = 0.5 + alpha * double( i );
+    return sampling_FromDouble( x - floor( x ) );
+}
+
+uint32_t sampling_R2( uint32_t i, int dim, int numDims )
+{
+    return sampling_R2( i, sampling_R2Alpha( dim, numDims ) );
+}
+
+// i / N in the first dimension, then radical inverses in successive primes.
+//
+uint32_t sampling_Hammersley( uint32_t i, int dim, uint32_t numSamples )
+{
+    static const uint32_t primes[] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107,
+        109, 113, 127, 131
+    };
+    if ( dim == 0 ) {
+        return sampling_FromDouble( double( i % numSamples ) / double( numSamples ) );
+    }
+    return sampling_RadicalInverse( i, primes[( dim - 1 ) % ( sizeof( primes ) / sizeof( primes[0] ) )] );
+}
+
+bool sampling_ParseSequence( std::string name, SampleSequence& sequence )
+{
+    if ( name == "sobol" ) {
+        sequence = SAMPLE_SEQUENCE_SOBOL;
+    } else if ( name == "owen" ) {
+        sequence = SAMPLE_SEQUENCE_SOBOL_OWEN;
+    } else if ( name == "r2" ) {
+        sequence = SAMPLE_SEQUENCE_R2;
+    } else if ( name == "hammersley" ) {
+        sequence = SAMPLE_SEQUENCE_HAMMERSLEY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Points are written sample major. Plain Sobol is generated a block at a time in natural order: going from i - 1
+// to i flips the trailing one bits of i, so each point is the previous one xor a prefix xor of the directions.
+//
+void sampling_Generate( SampleSequence sequence, int numSamples, int numDims, uint32_t seed, std::vector< uint32_t >& points )
+{
+    points.resize( size_t( numSamples ) * numDims );
+    int numBlocks = ( numSamples + SAMPLING_BLOCK_SIZE - 1 ) / SAMPLING_BLOCK_SIZE;
+    baker_parallelFor( numBlocks, [&]( int block ) {
+        int begin = block * SAMPLING_BLOCK_SIZE;
+        int end = min( begin + SAMPLING_BLOCK_SIZE, numSamples );
+        for( int d = 0; d < numDims; d++ ) {
+            if ( sequence == SAMPLE_SEQUENCE_SOBOL ) {
+                const uint32_t* v = sampling_SobolDirections().v[d];
+                uint32_t flips[32];
+                flips[0] = v[0];
+                for( int k = 1; k < 32; k++ ) flips[k] = flips[k - 1] ^ v[k];
+
+                uint32_t x = sampling_Sobol( begin, d );
+                points[size_t( begin ) * numDims + d] = x;
+                for( int i = begin + 1; i < end; i++ ) {
+                    int k = 0;
+                    while ( !( ( i >> k ) & 1 ) ) k++;
+                    x ^= flips[k];
+                    points[size_t( i ) * numDims + d] = x;
+                }
+                continue;
+            }
+            double alpha = sampling_R2Alpha( d, numDims );
+            for( int i = begin; i < end; i++ ) {
+                uint32_t x = 0;
+                switch ( sequence ) {
+                case SAMPLE_SEQUENCE_SOBOL_OWEN: x = sampling_SobolOwen( i, d, seed ); break;
+                case SAMPLE_SEQUENCE_R2: x = sampling_R2( i, alpha ); break;
+                default: x = sampling_Hammersley( i, d, numSamples ); break;
+                }
+                points[size_t( i ) * numDims + d] = x;
+            }
+        }
+    } );
+}
+
+// Raw little endian tables, numSamples x numDims, either float in [ 0, 1 ) or 32-bit fixed point uint. One job
+// per sequence.
+//
+void bake_sampleSequences( BakeGraph& graph, const std::vector< std::string >& names, int numSamples, int numDims, uint32_t seed, bool asUint )
+{
+    numSamples = max( numSamples, 1 );
+    numDims = max( numDims, 1 );
+    for( auto& name : names ) {
+        SampleSequence sequence;
+        if ( !sampling_ParseSequence( name, sequence ) ) {
+            printf( "Unknown sample sequence %s, skipping.\n", name.c_str() );
+            continue;
+        }
+        if ( ( sequence == SAMPLE_SEQUENCE_SOBOL || sequence == SAMPLE_SEQUENCE_SOBOL_OWEN ) && numDims > SAMPLING_SOBOL_MAX_DIMS ) {
+            printf( "Sobol sequences only have direction numbers for %d dimensions, skipping %s.\n", SAMPLING_SOBOL_MAX_DIMS, name.c_str() );
+            continue;
+        }
+
+        baker_addJob( graph, "samples_" + name, [=]() {
+            char outputFileName[512];
+            snprintf( outputFileName, sizeof( outputFileName ), "output/samples_%s_%dx%d.bin", name.c_str(), numSamples, numDims );
+            printf( "Baking %d x %d %s samples into %s ...\n", numSamples, numDims, name.c_str(), outputFileName );
+
+            std::vector< uint32_t > points;
+            sampling_Generate( sequence, numSamples, numDims, seed, points );
+
+            FILE* fp = fopen( outputFileName, "wb" );
+            if ( !fp ) {
+                printf( "    Failed to open %s.\n", outputFileName );
+                return;
+            }
+            if ( asUint ) {
+                fwrite( points.data(), sizeof( uint32_t ), points.size(), fp );
+            } else {
+                std::vector< float > values( points.size() );
+                for( size_t i = 0; i < points.size(); i++ ) values[i] = sampling_ToFloat( points[i] );
+                fwrite( values.data(), sizeof( float ), values.size(), fp );
+            }
+            fclose( fp );
+            printf( "    Output to %s OK.\n\n", outputFileName );
+        } );
+    }
+}
+
+#define SAMPLING_TILE_INTEGRANDS 32
+#define SAMPLING_TILE_MAX_LEVELS 17
+#define SAMPLING_TILE_REFERENCE_SAMPLES 65536
+#define SAMPLING_TILE_SIGMA 2.1f
+#define SAMPLING_TILE_RADIUS 4
+#define SAMPLING_TILE_CHECKPOINT_MAGIC 0x314b5253 // "SRK1"
+#define SAMPLING_TILE_CHECKPOINT_SECONDS 30
+
+struct SampleTileState
+{
+    int res;
+    int numDims;
+    int samplesPerPixel;
+    int bits;
+    int numLevels;  // One per power of two sample count up to samplesPerPixel.
+    int errorSize;  // numLevels * SAMPLING_TILE_INTEGRANDS
+
+    std::vector< uint32_t > sequence;   // samplesPerPixel x numDims, top bits only.
+    std::vector< vec3 > integrands;     // Heaviside steps, 1 where dot( vec3( x, y, 1 ), edge ) > 0.
+    std::vector< float > references;
+    std::vector< float > levelScales;   // Brings errors of every sample count to the same scale.
+    std::vector< float > weights;       // Image space falloff over the ( 2 * radius + 1 )^2 window.
+};
+
+// Keys and current error vectors of every pixel, for one pair of dimensions.
+struct SampleTilePair
+{
+    std::vector< uint16_t > scrambles[2];
+    std::vector< uint16_t > ranks;
+    std::vector< float > errors;
+};
+
+struct SampleTileCheckpointHeader
+{
+    uint32_t magic;
+    int res;
+    int numDims;
+    int samplesPerPixel;
+    uint32_t seed;
+    int iteration;
+};
+
+// Error of every integrand after each power of two prefix of the pixel's samples. Sample i of the pixel is
+// sequence point i ^ rank, xor'ed with the pixel's scrambles; both keep every power of two prefix a net.
+//
+void sampling_TileErrors( const SampleTileState& s, int pair, uint32_t scramble0, uint32_t scramble1, uint32_t rank, float* errors )
+{
+    float scale = 1.0f / float( 1 << s.bits );
+    float sums[SAMPLING_TILE_INTEGRANDS] = {};
+    int level = 0;
+    for( int i = 0; i < s.samplesPerPixel; i++ ) {
+        const uint32_t* v = &s.sequence[size_t( i ^ rank ) * s.numDims + pair * 2];
+        vec3 x( ( float( v[0] ^ scramble0 ) + 0.5f ) * scale, ( float( v[1] ^ scramble1 ) + 0.5f ) * scale, 1.0f );
+        for( int t = 0; t < SAMPLING_TILE_INTEGRANDS; t++ ) {
+            sums[t] += dot( x, s.integrands[t] ) > 0.0f ? 1.0f : 0.0f;
+        }
+        if ( ( ( i + 1 ) & i ) == 0 ) {
+            for( int t = 0; t < SAMPLING_TILE_INTEGRANDS; t++ ) {
+                errors[level * SAMPLING_TILE_INTEGRANDS + t] = ( sums[t] / float( i + 1 ) - s.references[t] ) * s.levelScales[level];
+            }
+            level++;
+        }
+    }
+}
+
+void sampling_TileUpdateErrors( const SampleTileState& s, SampleTilePair& pair, int k, int p )
+{
+    sampling_TileErrors( s, k, pair.scrambles[0][p], pair.scrambles[1][p], pair.ranks[p], &pair.errors[size_t( p ) * s.errorSize] );
+}
+
+float sampling_TileSimilarity( const float* a, const float* b, int size )
+{
+    float d = 0.0f;
+    for( int i = 0; i < size; i++ ) {
+        d += ( a[i] - b[i] ) * ( a[i] - b[i] );
+    }
+    return exp( -d );
+}
+
+// Falloff between two pixels of the wrapping tile, 0 outside the window.
+float sampling_TileWeight( const SampleTileState& s, int p, int q )
+{
+    int dx = ( q % s.res - p % s.res + s.res ) % s.res;
+    int dy = ( q / s.res - p / s.res + s.res ) % s.res;
+    if ( dx > s.res / 2 ) dx -= s.res;
+    if ( dy > s.res / 2 ) dy -= s.res;
+    if ( abs( dx ) > SAMPLING_TILE_RADIUS || abs( dy ) > SAMPLING_TILE_RADIUS ) return 0.0f;
+    return s.weights[( dy + SAMPLING_TILE_RADIUS ) * ( 2 * SAMPLING_TILE_RADIUS + 1 ) + dx + SAMPLING_TILE_RADIUS];
+}
+
+// Energy between pixel p, given error vector e, and its window of neighbours other than pixel skip.
+float sampling_TileEnergy( const SampleTileState& s, const SampleTilePair& pair, int p, const float* e, int skip )
+{
+    int px = p % s.res, py = p / s.res;
+    float energy = 0.0f;
+    for( int dy = -SAMPLING_TILE_RADIUS; dy <= SAMPLING_TILE_RADIUS; dy++ ) {
+        int y = ( py + dy + s.res ) % s.res;
+        for( int dx = -SAMPLING_TILE_RADIUS; dx <= SAMPLING_TILE_RADIUS; dx++ ) {
+            int n = y * s.res + ( px + dx + s.res ) % s.res;
+            if ( n == p || n == skip ) continue;
+            float w = s.weights[( dy + SAMPLING_TILE_RADIUS ) * ( 2 * SAMPLING_TILE_RADIUS + 1 ) + dx + SAMPLING_TILE_RADIUS];
+            energy += w * sampling_TileSimilarity( e, &pair.errors[size_t( n ) * s.errorSize], s.errorSize );
+        }
+    }
+    return energy;
+}
+
+// Swaps the keys picked by mask ( scramble 0, scramble 1, rank ) between pixels p and q if that lowers the energy.
+// Swapping rather than redrawing keeps each key's distribution over the tile exactly as initialized.
+//
+bool sampling_TileSwap( const SampleTileState& s, SampleTilePair& pair, int k, int p, int q, int mask )
+{
+    uint32_t keys[2][3] = {
+        { pair.scrambles[0][p], pair.scrambles[1][p], pair.ranks[p] },
+        { pair.scrambles[0][q], pair.scrambles[1][q], pair.ranks[q] }
+    };
+    for( int c = 0; c < 3; c++ ) {
+        if ( mask & ( 1 << c ) ) std::swap( keys[0][c], keys[1][c] );
+    }
+    float errors[2][SAMPLING_TILE_MAX_LEVELS * SAMPLING_TILE_INTEGRANDS];
+    sampling_TileErrors( s, k, keys[0][0], keys[0][1], keys[0][2], errors[0] );
+    sampling_TileErrors( s, k, keys[1][0], keys[1][1], keys[1][2], errors[1] );
+
+    const float* ep = &pair.errors[size_t( p ) * s.errorSize];
+    const float* eq = &pair.errors[size_t( q ) * s.errorSize];
+    float w = sampling_TileWeight( s, p, q );
+    float before = sampling_TileEnergy( s, pair, p, ep, q ) + sampling_TileEnergy( s, pair, q, eq, p );
+    float after = sampling_TileEnergy( s, pair, p, errors[0], q ) + sampling_TileEnergy( s, pair, q, errors[1], p );
+    if ( w > 0.0f ) {
+        before += w * sampling_TileSimilarity( ep, eq, s.errorSize );
+        after += w * sampling_TileSimilarity( errors[0], errors[1], s.errorSize );
+    }
+    if ( after >= before ) return false;
+
+    pair.scrambles[0][p] = uint16_t( keys[0][0] ), pair.scrambles[1][p] = uint16_t( keys[0][1] ), pair.ranks[p] = uint16_t( keys[0][2] );
+    pair.scrambles[0][q] = uint16_t( keys[1][0] ), pair.scrambles[1][q] = uint16_t( keys[1][1] ), pair.ranks[q] = uint16_t( keys[1][2] );
+    std::copy( errors[0], errors[0] + s.errorSize, pair.errors.begin() + size_t( p ) * s.errorSize );
+    std::copy( errors[1], errors[1] + s.errorSize, pair.errors.begin() + size_t( q ) * s.errorSize );
+    return true;
+}
+
+void sampling_TileRandomKeys( const SampleTileState& s, uint32_t seed, int k, SampleTilePair& pair )
+{
+    int numPixels = s.res * s.res;
+    for( int c = 0; c < 2; c++ ) pair.scrambles[c].resize( numPixels );
+    pair.ranks.resize( numPixels );
+    for( int p = 0; p < numPixels; p++ ) {
+        pair.scrambles[0][p] = uint16_t( baker_hash( seed, p, k, 0 ) >> ( 32 - s.bits ) );
+        pair.scrambles[1][p] = uint16_t( baker_hash( seed, p, k, 1 ) >> ( 32 - s.bits ) );
+        pair.ranks[p] = uint16_t( baker_hash( seed, p, k, 2 ) & uint32_t( s.samplesPerPixel - 1 ) );
+    }
+}
+
+void sampling_TileInit( SampleTileState& s, uint32_t seed )
+{
+    s.numLevels = 1;
+    while ( ( 1 << ( s.numLevels - 1 ) ) < s.samplesPerPixel ) s.numLevels++;
+    s.errorSize = s.numLevels * SAMPLING_TILE_INTEGRANDS;
+
+    s.sequence.resize( size_t( s.samplesPerPixel ) * s.numDims );
+    for( int i = 0; i < s.samplesPerPixel; i++ ) {
+        for( int d = 0; d < s.numDims; d++ ) {
+            s.sequence[size_t( i ) * s.numDims + d] = sampling_SobolOwen( i, d, seed ) >> ( 32 - s.bits );
+        }
+    }
+
+    // Random edges through the unit square, integrated against a dense Sobol set for reference.
+    s.integrands.resize( SAMPLING_TILE_INTEGRANDS );
+    s.references.assign( SAMPLING_TILE_INTEGRANDS, 0.0f );
+    for( int t = 0; t < SAMPLING_TILE_INTEGRANDS; t++ ) {
+        vec2 c( baker_random( seed, t, 0, 3 ), baker_random( seed, t, 1, 3 ) );
+        float phi = baker_random( seed, t, 2, 3 ) * 2.0f * PI;
+        vec2 n( cos( phi ), sin( phi ) );
+        s.integrands[t] = vec3( n, -dot( c, n ) );
+
+        int inside = 0;
+        for( int i = 0; i < SAMPLING_TILE_REFERENCE_SAMPLES; i++ ) {
+            vec3 x( sampling_ToFloat( sampling_Sobol( i, 0 ) ), sampling_ToFloat( sampling_Sobol( i, 1 ) ), 1.0f );
+            inside += dot( x, s.integrands[t] ) > 0.0f ? 1 : 0;
+        }
+        s.references[t] = float( inside ) / float( SAMPLING_TILE_REFERENCE_SAMPLES );
+    }
+
+    int width = 2 * SAMPLING_TILE_RADIUS + 1;
+    s.weights.resize( width * width );
+    for( int dy = -SAMPLING_TILE_RADIUS; dy <= SAMPLING_TILE_RADIUS; dy++ ) {
+        for( int dx = -SAMPLING_TILE_RADIUS; dx <= SAMPLING_TILE_RADIUS; dx++ ) {
+            float d2 = float( dx * dx + dy * dy );
+            s.weights[( dy + SAMPLING_TILE_RADIUS ) * width + dx + SAMPLING_TILE_RADIUS] = exp( -d2 / ( SAMPLING_TILE_SIGMA * SAMPLING_TILE_SIGMA ) );
+        }
+    }
+
+    // Scale each sample count's errors to unit RMS under random keys, then the whole vector so two unrelated
+    // pixels are around distance 2 apart.
+    int numPixels = s.res * s.res;
+    SampleTilePair pair;
+    sampling_TileRandomKeys( s, seed, 0, pair );
+    pair.errors.resize( size_t( numPixels ) * s.errorSize );
+    s.levelScales.assign( s.numLevels, 1.0f );
+    for( int p = 0; p < numPixels; p++ ) sampling_TileUpdateErrors( s, pair, 0, p );
+    for( int l = 0; l < s.numLevels; l++ ) {
+        double sum = 0.0;
+        for( int p = 0; p < numPixels; p++ ) {
+            for( int t = 0; t < SAMPLING_TILE_INTEGRANDS; t++ ) {
+                double e = pair.errors[size_t( p ) * s.errorSize + l * SAMPLING_TILE_INTEGRANDS + t];
+                sum += e * e;
+            }
+        }
+        double rms = sqrt( sum / double( numPixels * SAMPLING_TILE_INTEGRANDS ) );
+        s.levelScales[l] = float( 1.0 / ( max( rms, 1e-6 ) * sqrt( double( s.errorSize ) ) ) );
+    }
+}
+
+bool sampling_TileLoadCheckpoint( std::string fileName, SampleTileCheckpointHeader& header, std::vector< SampleTilePair >& pairs )
+{
+    FILE* fp = fopen( fileName.c_str(), "rb" );
+    if ( !fp ) return false;
+    SampleTileCheckpointHeader h;
+    bool ok = fread( &h, sizeof( h ), 1, fp ) == 1 && h.magic == header.magic && h.res == header.res &&
+              h.numDims == header.numDims && h.samplesPerPixel == header.samplesPerPixel && h.seed == header.seed;
+    for( auto& pair : pairs ) {
+        for( int c = 0; c < 2; c++ ) {
+            ok = ok && fread( pair.scrambles[c].data(), sizeof( uint16_t ), pair.scrambles[c].size(), fp ) == pair.scrambles[c].size();
+        }
+        ok = ok && fread( pair.ranks.data(), sizeof( uint16_t ), pair.ranks.size(), fp ) == pair.ranks.size();
+    }
+    fclose( fp );
+    if ( ok ) header.iteration = h.iteration;
+    return ok;
+}
+
+void sampling_TileSaveCheckpoint( std::string fileName, const SampleTileCheckpointHeader& header, const std::vector< SampleTilePair >& pairs )
+{
+    // Written aside and swapped in, so an interrupted save leaves the last checkpoint intact.
+    namespace fs = std::experimental::filesystem;
+    std::string tempFileName = fileName + ".tmp";
+    FILE* fp = fopen( tempFileName.c_str(), "wb" );
+    if ( !fp ) return;
+    fwrite( &header, sizeof( header ), 1, fp );
+    for( auto& pair : pairs ) {
+        for( int c = 0; c < 2; c++ ) {
+            fwrite( pair.scrambles[c].data(), sizeof( uint16_t ), pair.scrambles[c].size(), fp );
+        }
+        fwrite( pair.ranks.data(), sizeof( uint16_t ), pair.ranks.size(), fp );
+    }
+    fclose( fp );
+    std::error_code ec;
+    fs::rename( tempFileName, fileName, ec );
+}
+
+// uint8 when bits is 8, otherwise uint16, little endian.
+bool sampling_WriteTable( std::string fileName, const std::vector< uint32_t >& values, int bits )
+{
+    FILE* fp = fopen( fileName.c_str(), "wb" );
+    if ( !fp ) {
+        printf( "    Failed to open %s.\n", fileName.c_str() );
+        return false;
+    }
+    if ( bits == 8 ) {
+        std::vector< uint8_t > data( values.begin(), values.end() );
+        fwrite( data.data(), 1, data.size(), fp );
+    } else {
+        std::vector< uint16_t > data( values.begin(), values.end() );
+        fwrite( data.data(), sizeof( uint16_t ), data.size(), fp );
+    }
+    fclose( fp );
+    printf( "    Output to %s OK.\n", fileName.c_str() );
+    return true;
+}
+
+std::string sampling_TileBaseName( int res, int samplesPerPixel )
+{
+    char name[256];
+    snprintf( name, sizeof( name ), "%d_%dspp", res, samplesPerPixel );
+    return name;
+}
+
+// Dimension pairs are optimized in parallel, a sweep at a time. Checkpoints go next to the output.
+//
+bool sampling_OptimizeScramblingTiles( const SampleTileSettings& settings, bool checkpoint, SampleTiles& tiles )
+{
+    BAKER_TRACE_SCOPE( "optimize scrambling tiles" );
+    SampleTileState s;
+    s.res = clamp( settings.res, 2 * SAMPLING_TILE_RADIUS + 2, 1024 );
+    s.numDims = clamp( settings.numDims & ~1, 2, SAMPLING_SOBOL_MAX_DIMS & ~1 );
+    s.samplesPerPixel = 1;
+    while ( s.samplesPerPixel < settings.samplesPerPixel && s.samplesPerPixel < ( 1 << ( SAMPLING_TILE_MAX_LEVELS - 1 ) ) ) {
+        s.samplesPerPixel *= 2;
+    }
+    s.bits = s.samplesPerPixel <= 256 ? 8 : 16;
+    int numPairs = s.numDims / 2;
+    int numPixels = s.res * s.res;
+    printf( "Baking %dx%d sample scrambling tile, %d spp x %d dimensions ...\n", s.res, s.res, s.samplesPerPixel, s.numDims );
+
+    sampling_TileInit( s, settings.seed );
+    std::vector< SampleTilePair > pairs( numPairs );
+    for( int k = 0; k < numPairs; k++ ) {
+        sampling_TileRandomKeys( s, settings.seed, k, pairs[k] );
+        pairs[k].errors.resize( size_t( numPixels ) * s.errorSize );
+    }
+
+    std::string checkpointFileName = "output/scramblingTile_" + sampling_TileBaseName( s.res, s.samplesPerPixel ) + ".checkpoint";
+    SampleTileCheckpointHeader header = { SAMPLING_TILE_CHECKPOINT_MAGIC, s.res, s.numDims, s.samplesPerPixel, settings.seed, 0 };
+    if ( checkpoint && sampling_TileLoadCheckpoint( checkpointFileName, header, pairs ) ) {
+        printf( "    Resuming %s at iteration %d ...\n", checkpointFileName.c_str(), header.iteration );
+    }
+    baker_parallelFor( numPairs, [&]( int k ) {
+        for( int p = 0; p < numPixels; p++ ) sampling_TileUpdateErrors( s, pairs[k], k, p );
+    } );
+
+    // Each move swaps all keys, one scramble or the rank of two pixels; the first gets decorrelated error
+    // vectors into place, the others find new combinations.
+    static const int masks[] = { 7, 1, 2, 4 };
+    int numMasks = s.samplesPerPixel > 1 ? 4 : 3;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    for( ; header.iteration < settings.iterations; header.iteration++ ) {
+        auto now = std::chrono::steady_clock::now();
+        if ( checkpoint && now - lastCheckpoint >= std::chrono::seconds( SAMPLING_TILE_CHECKPOINT_SECONDS ) ) {
+            sampling_TileSaveCheckpoint( checkpointFileName, header, pairs );
+            lastCheckpoint = now;
+        }
+
+        std::atomic< int > accepted( 0 );
+        baker_parallelFor( numPairs, [&]( int k ) {
+            int count = 0;
+            for( int j = 0; j < numPixels && !baker_cancelled(); j++ ) {
+                uint32_t h = baker_hash( settings.seed, j, header.iteration, 4 + k );
+                int p = int( h % uint32_t( numPixels ) );
+                int q = int( baker_hash( h ) % uint32_t( numPixels ) );
+                if ( p == q ) continue;
+                count += sampling_TileSwap( s, pairs[k], k, p, q, masks[baker_hash( h + 1 ) % uint32_t( numMasks )] ) ? 1 : 0;
+            }
+            accepted += count;
+        } );
+        if ( baker_cancelled() ) break;
+        printf( "    Iteration %d / %d, %.2f%% swaps accepted\n", header.iteration + 1, settings.iterations,
+                100.0f * float( accepted ) / float( numPixels * numPairs ) );
+    }
+
+    if ( baker_cancelled() ) {
+        if ( checkpoint ) sampling_TileSaveCheckpoint( checkpointFileName, header, pairs );
+        return false;
+    }
+
+    tiles.res = s.res;
+    tiles.numDims = s.numDims;
+    tiles.samplesPerPixel = s.samplesPerPixel;
+    tiles.bits = s.bits;
+    tiles.sequence = s.sequence;
+    tiles.scrambling.resize( size_t( numPixels ) * s.numDims );
+    tiles.ranking.resize( size_t( numPixels ) * numPairs );
+    for( int p = 0; p < numPixels; p++ ) {
+        for( int k = 0; k < numPairs; k++ ) {
+            tiles.scrambling[size_t( p ) * s.numDims + k * 2] = pairs[k].scrambles[0][p];
+            tiles.scrambling[size_t( p ) * s.numDims + k * 2 + 1] = pairs[k].scrambles[1][p];
+            tiles.ranking[size_t( p ) * numPairs + k] = pairs[k].ranks[p];
+        }
+    }
+    return true;
+}
+
+// Writes three tables, 8 bits per entry up to 256 samples per pixel and 16 bits beyond:
+//
+//   output/sobol_<spp>spp_<dims>d.bin               sequence, spp x dims
+//   output/scramblingTile_<res>_<spp>spp.bin        per pixel scrambling keys, res x res x dims
+//   output/rankingTile_<res>_<spp>spp.bin           per pixel ranking keys, res x res x ( dims / 2 )
+//
+// Sample i of pixel p in dimension d is then
+//
+//   ( ( sobol[( i ^ ranking[p][d / 2] ) * dims + d] ^ scrambling[p][d] ) + 0.5 ) / 2^bits
+//
+// with the tile repeated over the screen. Progress is checkpointed, so an interrupted bake picks up where it
+// left off.
+//
+void sampling_BakeScramblingTiles( const SampleTileSettings& settings )
+{
+    SampleTiles tiles;
+    if ( !sampling_OptimizeScramblingTiles( settings, true, tiles ) ) {
+        return;
+    }
+
+    std::string name = sampling_TileBaseName( tiles.res, tiles.samplesPerPixel );
+    char outputFileName[512];
+    snprintf( outputFileName, sizeof( outputFileName ), "output/sobol_%dspp_%dd.bin", tiles.samplesPerPixel, tiles.numDims );
+    bool ok = sampling_WriteTable( outputFileName, tiles.sequence, tiles.bits );
+    ok = sampling_WriteTable( "output/scramblingTile_" + name + ".bin", tiles.scrambling, tiles.bits ) && ok;
+    ok = sampling_WriteTable( "output/rankingTile_" + name + ".bin", tiles.ranking, tiles.bits ) && ok;
+    if ( ok ) {
+        std::remove( ( "output/scramblingTile_" + name + ".checkpoint" ).c_str() );
+    }
+    printf( "\n" );
+}
+
+void bake_sampleScramblingTiles( BakeGraph& graph, const SampleTileSettings& settings )
+{
+    baker_addJob( graph, "scramblingTile", [=]() { sampling_BakeScramblingTiles( settings ); } );
+}
@@ -0,0 +1,100 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+
+// Low-discrepancy sequences. Points are 32-bit fixed point in [ 0, 1 ), indexed by sample and dimension, and
+// every generator is a pure function of its inputs, so tables and integrators can evaluate them on any thread.
+enum SampleSequence
+{
+    SAMPLE_SEQUENCE_SOBOL,
+    SAMPLE_SEQUENCE_SOBOL_OWEN,
+    SAMPLE_SEQUENCE_R2,
+    SAMPLE_SEQUENCE_HAMMERSLEY
+};
+
+#define SAMPLING_SOBOL_MAX_DIMS 21
+
+inline uint32_t sampling_ReverseBits( uint32_t x )
+{
+    x = ( x << 16 ) | ( x >> 16 );
+    x = ( ( x & 0x00ff00ffu ) << 8 ) | ( ( x & 0xff00ff00u ) >> 8 );
+    x = ( ( x & 0x0f0f0f0fu ) << 4 ) | ( ( x & 0xf0f0f0f0u ) >> 4 );
+    x = ( ( x & 0x33333333u ) << 2 ) | ( ( x & 0xccccccccu ) >> 2 );
+    x = ( ( x & 0x55555555u ) << 1 ) | ( ( x & 0xaaaaaaaau ) >> 1 );
+    return x;
+}
+
+float sampling_ToFloat( uint32_t x );
+
+uint32_t sampling_RadicalInverse( uint32_t i, uint32_t base );
+uint32_t sampling_Sobol( uint32_t i, int dim );
+uint32_t sampling_OwenScramble( uint32_t x, uint32_t seed );
+uint32_t sampling_SobolOwen( uint32_t i, int dim, uint32_t seed );
+uint32_t sampling_R2( uint32_t i, int dim, int numDims );
+uint32_t sampling_Hammersley( uint32_t i, int dim, uint32_t numSamples );
+
+// Same values as the hammersley_sequence( 0, N, 2, N ) table the integrators used to build. Inline, so integrators
+// instantiated for one sample count fold the division.
+inline glm::vec2 sampling_Hammersley2D( uint32_t i, uint32_t numSamples )
+{
+    return glm::vec2( float( double( i ) / double( numSamples ) ), float( double( sampling_ReverseBits( i ) ) / 4294967296.0 ) );
+}
+
+bool sampling_ParseSequence( std::string name, SampleSequence& sequence );
+void sampling_Generate( SampleSequence sequence, int numSamples, int numDims, uint32_t seed, std::vector< uint32_t >& points );
+
+void bake_sampleSequences( BakeGraph& graph, const std::vector< std::string >& names, int numSamples, int numDims, uint32_t seed, bool asUint );
+
+// Per-pixel keys that decorrelate a shared Owen scrambled Sobol sequence across a screen-space tile, optimized so
+// the integration error of neighbouring pixels differs as much as possible, ie. is distributed as blue noise.
+//
+// ref: "A Low-Discrepancy Sampler that Distributes Monte Carlo Errors as a Blue Noise in Screen Space"
+//      by Heitz et. al
+//
+struct SampleTileSettings
+{
+    uint32_t seed = 0;
+    int res = 128;
+    int samplesPerPixel = 16; // Rounded up to a power of two, keys stay good for every power of two count below it.
+    int numDims = 8;          // Optimized in pairs.
+    int iterations = 16;      // Passes over the tile, each trying a swap per pixel and dimension pair.
+};
+
+// Optimized keys, bits per entry wide. Sample i of pixel p in dimension d is
+//
+//   ( ( sequence[( i ^ ranking[p][d / 2] ) * dims + d] ^ scrambling[p][d] ) + 0.5 ) / 2^bits
+//
+struct SampleTiles
+{
+    int res = 0;
+    int numDims = 0;
+    int samplesPerPixel = 0;
+    int bits = 0;
+    std::vector< uint32_t > sequence;    // samplesPerPixel x numDims.
+    std::vector< uint32_t > scrambling;  // res x res x numDims.
+    std::vector< uint32_t > ranking;     // res x res x ( numDims / 2 ).
+};
+
+// Returns false if cancelled. With checkpoint set, progress is saved periodically and when cancelled, and
+// resumed from a matching checkpoint.
+bool sampling_OptimizeScramblingTiles( const SampleTileSettings& settings, bool checkpoint, SampleTiles& tiles );
+
+void bake_sampleScramblingTiles( BakeGraph& graph, const SampleTileSettings& settings );
@@ -0,0 +1,234 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "server.h"
+#include "libpbrbaker.h"
+
+#include <iostream>
+#include <sstream>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#if defined( _WIN32 )
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace glm;
+
+struct ServeRequest
+{
+    int id;
+    std::string manifest;
+};
+
+struct ServeState
+{
+    FILE* out;
+    std::mutex writeMutex;      // Keeps replies from different outputs whole.
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque< ServeRequest > queue;
+    int running = 0;            // Request being baked, 0 when idle.
+    bool quit = false;
+};
+
+// Takes stdout over for the protocol, and points everything printed at stderr.
+//
+FILE* serve_OpenProtocol()
+{
+    fflush( stdout );
+#if defined( _WIN32 )
+    int fd = _dup( _fileno( stdout ) );
+    _dup2( _fileno( stderr ), _fileno( stdout ) );
+    _setmode( fd, _O_BINARY );
+    FILE* out = _fdopen( fd, "wb" );
+#else
+    int fd = dup( fileno( stdout ) );
+    dup2( fileno( stderr ), fileno( stdout ) );
+    FILE* out = fdopen( fd, "wb" );
+#endif
+    setvbuf( stdout, nullptr, _IONBF, 0 );
+    return out;
+}
+
+void serve_Reply( ServeState& state, const char* reply, int id )
+{
+    std::lock_guard< std::mutex > lock( state.writeMutex );
+    fprintf( state.out, "%s %d\n", reply, id );
+    fflush( state.out );
+}
+
+// Texels of an output as last streamed, so each refinement only sends the tiles that changed.
+struct ServeStream
+{
+    std::vector< float > sent;
+};
+
+// Streams the tiles of texels that differ from those sent before, the output line first, then a refined line with
+// the percentage of texels evaluated, or for the final texels, percent < 0, a ready line. The calls for one output
+// come one after another; different outputs stream concurrently.
+//
+void serve_StreamOutput( ServeState& state, int id, int o, const ManifestOutput& output, const std::vector< float >& texels,
+                         int tileSize, ServeStream& stream, int percent )
+{
+    int res = output.resolution;
+    int numChannels = pbrbaker_ImageChannels( output );
+    bool first = stream.sent.empty();
+
+    std::lock_guard< std::mutex > lock( state.writeMutex );
+    if ( first ) {
+        fprintf( state.out, "output %d %d %s %d %d\n", id, o, output.name.c_str(), res, numChannels );
+    }
+    for( int y = 0; y < res; y += tileSize ) {
+        for( int x = 0; x < res; x += tileSize ) {
+            int width = min( tileSize, res - x );
+            int height = min( tileSize, res - y );
+            bool changed = first;
+            for( int row = y; row < y + height && !changed; row++ ) {
+                size_t offset = size_t( row * res + x ) * numChannels;
+                changed = !std::equal( &texels[offset], &texels[offset] + width * numChannels, &stream.sent[offset] );
+            }
+            if ( !changed ) continue;
+
+            fprintf( state.out, "tile %d %d %d %d %d %d\n", id, o, x, y, width, height );
+            for( int row = y; row < y + height; row++ ) {
+                fwrite( &texels[( row * res + x ) * numChannels], sizeof( float ), width * numChannels, state.out );
+            }
+        }
+    }
+    if ( percent < 0 ) {
+        fprintf( state.out, "ready %d %d\n", id, o );
+    } else {
+        fprintf( state.out, "refined %d %d %d\n", id, o, percent );
+    }
+    fflush( state.out );
+    stream.sent = texels;
+}
+
+void serve_Bake( ServeState& state, PbrBaker* baker, const ServeSettings& settings, const ServeRequest& request )
+{
+    std::vector< ManifestOutput > outputs;
+    std::istringstream in( request.manifest );
+    manifest_Parse( in, "request " + std::to_string( request.id ), outputs );
+    if ( outputs.empty() ) {
+        std::lock_guard< std::mutex > lock( state.writeMutex );
+        fprintf( state.out, "error %d no valid outputs\n", request.id );
+        fflush( state.out );
+        return;
+    }
+
+    std::vector< std::vector< float > > texels( outputs.size() );
+    std::vector< float* > buffers;
+    for( int o = 0; o < int( outputs.size() ); o++ ) {
+        texels[o].resize( outputs[o].resolution * outputs[o].resolution * pbrbaker_ImageChannels( outputs[o] ) );
+        buffers.push_back( texels[o].data() );
+    }
+
+    int tileSize = max( settings.tileSize, 1 );
+    std::vector< ServeStream > streams( outputs.size() );
+    PbrBakerPreview refine = nullptr;
+    if ( settings.refineSeconds > 0.0 ) {
+        refine = [&]( int o, const std::vector< vec4 >& pixels, float fraction ) {
+            int numChannels = pbrbaker_ImageChannels( outputs[o] );
+            std::vector< float > refined( pixels.size() * numChannels );
+            for( size_t i = 0; i < pixels.size(); i++ ) {
+                std::copy( &pixels[i][0], &pixels[i][0] + numChannels, &refined[i * numChannels] );
+            }
+            serve_StreamOutput( state, request.id, o, outputs[o], refined, tileSize, streams[o], int( fraction * 100.0f ) );
+        };
+    }
+
+    printf( "Request %d: baking %d outputs ...\n", request.id, int( outputs.size() ) );
+    bool baked = pbrbaker_BakeImages( baker, outputs, buffers, [&]( int o ) {
+        serve_StreamOutput( state, request.id, o, outputs[o], texels[o], tileSize, streams[o], -1 );
+    }, refine, settings.refineSeconds );
+
+    serve_Reply( state, baked ? "done" : "cancelled", request.id );
+}
+
+void bake_serve( const ServeSettings& settings )
+{
+    ServeState state;
+    state.out = serve_OpenProtocol();
+    auto baker = pbrbaker_Create( settings.numThreads );
+    printf( "Serving bake requests on stdin.\n" );
+
+    std::thread worker( [&]() {
+        for( ;; ) {
+            ServeRequest request;
+            {
+                std::unique_lock< std::mutex > lock( state.mutex );
+                state.wake.wait( lock, [&]() { return state.queue.size() || state.quit; } );
+                if ( state.queue.empty() ) break;
+                request = state.queue.front();
+                state.queue.pop_front();
+                // Cancels only ever target the running request, so one left over from the last request, sent
+                // after its bake had finished, is dropped here. Any cancel from now on reaches this one's bake.
+                state.running = request.id;
+                pbrbaker_ClearCancel( baker );
+            }
+            serve_Bake( state, baker, settings, request );
+            std::lock_guard< std::mutex > lock( state.mutex );
+            state.running = 0;
+        }
+    } );
+
+    std::string manifest;
+    std::string line;
+    int numRequests = 0;
+    while ( std::getline( std::cin, line ) ) {
+        auto command = line;
+        command.erase( std::remove_if( command.begin(), command.end(), []( unsigned char c ) { return isspace( c ) != 0; } ), command.end() );
+        if ( command == "bake" ) {
+            std::lock_guard< std::mutex > lock( state.mutex );
+            state.queue.push_back( { ++numRequests, manifest } );
+            manifest.clear();
+            state.wake.notify_one();
+        } else if ( command == "cancel" ) {
+            std::lock_guard< std::mutex > lock( state.mutex );
+            for( auto& request : state.queue ) {
+                serve_Reply( state, "cancelled", request.id );
+            }
+            state.queue.clear();
+            if ( state.running ) {
+                pbrbaker_Cancel( baker );
+            }
+        } else if ( command == "quit" ) {
+            break;
+        } else {
+            manifest += line + "\n";
+        }
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( state.mutex );
+        state.quit = true;
+        state.wake.notify_one();
+    }
+    worker.join();
+    pbrbaker_Destroy( baker );
+    fclose( state.out );
+}
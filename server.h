@@ -0,0 +1,54 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+
+// Bake server for editors that rebake while artists tweak parameters. It keeps one library handle, and with it
+// the thread pool and baked tables, alive between requests. The protocol runs over stdin and stdout; progress
+// messages go to stderr instead.
+//
+// Requests are lines of manifest text, as in manifest.h, each followed by a command line:
+//
+//   bake       Bake the manifest lines sent since the last bake. Requests are numbered from 1 and queue up.
+//   cancel     Stop the running bake and drop queued ones.
+//   quit       Finish queued bakes and exit, as does the end of stdin.
+//
+// Replies are text lines, each tile followed by its texels as float32s in native byte order:
+//
+//   output <request> <output> <name> <resolution> <channels>   before the output's first tile
+//   tile <request> <output> <x> <y> <width> <height>           width x height texels of rows of channels floats
+//   refined <request> <output> <percent>                       the tiles since are a preview
+//   ready <request> <output>                                   the tiles since complete the final output
+//   done <request> | cancelled <request> | error <request> <message>
+//
+// Outputs stream in tiles of tileSize rows and columns. While BRDF and gloss tables bake coarse to fine, the outputs
+// reading them stream refinements every refineSeconds, only the tiles that changed, so editors see them sharpen;
+// channels from other tables are 0 until final. Once packed, each output streams the tiles that differ from the
+// last refinement, or all of them, and is ready; cached outputs straight away. A cancelled bake may have sent
+// refinements of outputs that never become ready.
+//
+struct ServeSettings
+{
+    int numThreads = 0;
+    int tileSize = 64;
+    double refineSeconds = 0.5; // 0 streams final outputs only.
+};
+
+void bake_serve( const ServeSettings& settings );
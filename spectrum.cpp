@@ -0,0 +1,295 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "blackbody.h"
+#include "spectrum.h"
+
+#include <fstream>
+#include <cstdint>
+#include <csv-parser/parser.hpp>
+
+using namespace glm;
+
+// Spectra are resampled onto a fixed 1nm grid over the visible range, which is also the layout of the binary cache.
+#define SPECTRUM_MIN_NM 380.0f
+#define SPECTRUM_MAX_NM 780.0f
+#define SPECTRUM_NUM_SAMPLES 401
+#define SPECTRUM_CACHE_MAGIC 0x31435053 // "SPC1"
+
+struct SpectrumCacheHeader
+{
+    uint32_t magic;
+    uint32_t numSamples;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+struct Spectrum
+{
+    std::string name;
+    std::vector< float > samples;
+    vec3 rgb;
+};
+
+bool spectrum_ParseColorSpace( std::string name, SpectrumColorSpace& colorSpace )
+{
+    if ( name == "srgb" ) {
+        colorSpace = SPECTRUM_COLORSPACE_SRGB;
+    } else if ( name == "rec2020" ) {
+        colorSpace = SPECTRUM_COLORSPACE_REC2020;
+    } else if ( name == "acescg" ) {
+        colorSpace = SPECTRUM_COLORSPACE_ACESCG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ref: https://www.itu.int/rec/R-REC-BT.2020
+// ref: https://docs.acescentral.com/specifications/acescg/
+//
+// sRGB and Rec.2020 share the D65 white point. ACEScg is D60, so XYZ is first adapted from D65 to D60 with the
+// Bradford transform, keeping a D65 white neutral in every working space.
+//
+vec3 spectrum_XYZToWorkingSpace( vec3 XYZ, SpectrumColorSpace colorSpace )
+{
+    switch ( colorSpace ) {
+    case SPECTRUM_COLORSPACE_REC2020:
+        return vec3(
+            dot( XYZ, vec3(  1.7166512f, -0.3556708f, -0.2533663f ) ),
+            dot( XYZ, vec3( -0.6666844f,  1.6164812f,  0.0157685f ) ),
+            dot( XYZ, vec3(  0.0176399f, -0.0427706f,  0.9421031f ) )
+        );
+    case SPECTRUM_COLORSPACE_ACESCG: {
+        vec3 XYZ_D60 = vec3(
+            dot( XYZ, vec3(  1.0130349f,  0.0061053f, -0.0149709f ) ),
+            dot( XYZ, vec3(  0.0076982f,  0.9981634f, -0.0050320f ) ),
+            dot( XYZ, vec3( -0.0028413f,  0.0046852f,  0.9245061f ) )
+        );
+        return vec3(
+            dot( XYZ_D60, vec3(  1.6410234f, -0.3248033f, -0.2364247f ) ),
+            dot( XYZ_D60, vec3( -0.6636629f,  1.6153316f,  0.0167563f ) ),
+            dot( XYZ_D60, vec3(  0.0117219f, -0.0082844f,  0.9883949f ) )
+        );
+    }
+    default:
+        return XYZ_to_sRGB_D50( XYZ );
+    }
+}
+
+// Reads wavelength ( nm ), intensity pairs from the first two columns. Rows that don't parse, like headers, are skipped.
+//
+bool spectrum_LoadCSV( std::string fileName, std::vector< float >& samples )
+{
+    std::ifstream f( fileName );
+    if ( !f.is_open() ) {
+        return false;
+    }
+
+    std::vector< vec2 > points;
+    aria::csv::CsvParser parser( f );
+    for( auto& row : parser ) {
+        if ( row.size() < 2 ) continue;
+        try {
+            points.push_back( vec2( std::stof( row[0] ), std::stof( row[1] ) ) );
+        } catch ( ... ) {
+            continue;
+        }
+    }
+    if ( points.size() < 2 ) {
+        return false;
+    }
+    std::sort( points.begin(), points.end(), []( vec2 a, vec2 b ) { return a.x < b.x; } );
+
+    // Linearly resample onto the fixed grid, zero outside the measured range.
+    samples.resize( SPECTRUM_NUM_SAMPLES );
+    size_t p = 0;
+    for( int i = 0; i < SPECTRUM_NUM_SAMPLES; i++ ) {
+        float l = mix( SPECTRUM_MIN_NM, SPECTRUM_MAX_NM, float( i ) / float( SPECTRUM_NUM_SAMPLES - 1 ) );
+        while ( p + 2 < points.size() && points[p + 1].x < l ) p++;
+        vec2 a = points[p], b = points[p + 1];
+        if ( l < a.x || l > b.x ) {
+            samples[i] = 0.0f;
+            continue;
+        }
+        float t = ( b.x - a.x ) > 0.0f ? ( l - a.x ) / ( b.x - a.x ) : 0.0f;
+        samples[i] = max( 0.0f, mix( a.y, b.y, t ) );
+    }
+    return true;
+}
+
+// Binary caches live in output/spectra, named after the CSV and a hash of its full path, and are only trusted if
+// the CSV's size and timestamp still match.
+//
+bool spectrum_LoadCache( std::string cacheFileName, const SpectrumCacheHeader& expected, std::vector< float >& samples )
+{
+    FILE* fp = fopen( cacheFileName.c_str(), "rb" );
+    if ( !fp ) {
+        return false;
+    }
+
+    SpectrumCacheHeader header;
+    bool ok = fread( &header, sizeof( header ), 1, fp ) == 1 &&
+        header.magic == expected.magic && header.numSamples == expected.numSamples &&
+        header.sourceSize == expected.sourceSize && header.sourceTime == expected.sourceTime;
+    if ( ok ) {
+        samples.resize( header.numSamples );
+        ok = fread( samples.data(), sizeof( float ), samples.size(), fp ) == samples.size();
+    }
+    fclose( fp );
+    return ok;
+}
+
+void spectrum_WriteCache( std::string cacheFileName, const SpectrumCacheHeader& header, const std::vector< float >& samples )
+{
+    // Written aside under a name unique to this writer and swapped in, so bakes of the same file at once never
+    // read a partial cache.
+    namespace fs = std::experimental::filesystem;
+    uint32_t writer = baker_hash( uint32_t( std::hash< std::thread::id >()( std::this_thread::get_id() ) ),
+                                  uint32_t( std::chrono::steady_clock::now().time_since_epoch().count() ), 0, 0 );
+    std::string tempFileName = cacheFileName + "." + std::to_string( writer ) + ".tmp";
+    FILE* fp = fopen( tempFileName.c_str(), "wb" );
+    if ( !fp ) {
+        return;
+    }
+    bool ok = fwrite( &header, sizeof( header ), 1, fp ) == 1 &&
+        fwrite( samples.data(), sizeof( float ), samples.size(), fp ) == samples.size();
+    fclose( fp );
+    std::error_code ec;
+    if ( ok ) {
+        fs::rename( tempFileName, cacheFileName, ec );
+    }
+    if ( !ok || ec ) {
+        fs::remove( tempFileName, ec );
+    }
+}
+
+std::string spectrum_CacheFileName( std::string fileName )
+{
+    namespace fs = std::experimental::filesystem;
+    auto path = fs::absolute( fileName );
+    char hash[16];
+    snprintf( hash, sizeof( hash ), "%08x", uint32_t( std::hash< std::string >()( path.u8string() ) ) );
+    return "output/spectra/" + path.stem().u8string() + "_" + hash + ".spc";
+}
+
+bool spectrum_Load( std::string fileName, std::vector< float >& samples )
+{
+    namespace fs = std::experimental::filesystem;
+    std::error_code ec;
+    SpectrumCacheHeader header;
+    header.magic = SPECTRUM_CACHE_MAGIC;
+    header.numSamples = SPECTRUM_NUM_SAMPLES;
+    header.sourceSize = uint64_t( fs::file_size( fileName, ec ) );
+    header.sourceTime = int64_t( fs::last_write_time( fileName, ec ).time_since_epoch().count() );
+    if ( ec ) {
+        return false;
+    }
+
+    std::string cacheFileName = spectrum_CacheFileName( fileName );
+    if ( spectrum_LoadCache( cacheFileName, header, samples ) ) {
+        return true;
+    }
+    if ( !spectrum_LoadCSV( fileName, samples ) ) {
+        return false;
+    }
+    fs::create_directories( fs::path( cacheFileName ).parent_path(), ec );
+    spectrum_WriteCache( cacheFileName, header, samples );
+    return true;
+}
+
+template< typename Sum >
+vec3 spectrum_IntegrateXYZ( const std::vector< float >& samples )
+{
+    Sum sum;
+    for( int i = 0; i < SPECTRUM_NUM_SAMPLES; i++ ) {
+        float l = mix( SPECTRUM_MIN_NM, SPECTRUM_MAX_NM, float( i ) / float( SPECTRUM_NUM_SAMPLES - 1 ) );
+        sum.add( nvFit_XYZ10( l ) * samples[i] );
+    }
+    return sum.value();
+}
+
+// Integrates against the CIE 1964 10-degree fit and normalizes to unit luminance, so the result is
+// the colour of the light and intensity can be applied separately.
+//
+vec3 spectrum_Integrate( const std::vector< float >& samples, SpectrumColorSpace colorSpace )
+{
+    vec3 XYZ = baker_referenceSums() ? spectrum_IntegrateXYZ< BakerDoubleSum< vec3 > >( samples )
+                                     : spectrum_IntegrateXYZ< BakerSum< vec3 > >( samples );
+    if ( XYZ.y > 0.0f ) {
+        XYZ /= XYZ.y;
+    }
+    return spectrum_XYZToWorkingSpace( XYZ, colorSpace );
+}
+
+void spectrum_BakeEmissionSpectra( const std::vector< std::string >& spectrumFiles, SpectrumColorSpace colorSpace )
+{
+    namespace fs = std::experimental::filesystem;
+    printf( "Baking %d emission spectra to output/emission_spectra.cpp...\n", int( spectrumFiles.size() ) );
+
+    std::vector< Spectrum > spectra( spectrumFiles.size() );
+    std::vector< char > loaded( spectrumFiles.size() );
+    baker_parallelFor( int( spectrumFiles.size() ), [&]( int i ) {
+        auto& s = spectra[i];
+        s.name = fs::path( spectrumFiles[i] ).stem().u8string();
+        loaded[i] = spectrum_Load( spectrumFiles[i], s.samples );
+        if ( loaded[i] ) {
+            s.rgb = spectrum_Integrate( s.samples, colorSpace );
+        }
+    } );
+
+    int numLoaded = 0;
+    for( size_t i = 0; i < spectra.size(); i++ ) {
+        if ( !loaded[i] ) {
+            printf( "    Failed to load spectrum %s, skipping.\n", spectrumFiles[i].c_str() );
+        } else {
+            numLoaded++;
+        }
+    }
+    if ( !numLoaded ) {
+        printf( "    No spectra loaded, nothing written.\n" );
+        return;
+    }
+
+    // Output to file as C code!
+    FILE* fp = fopen( "output/emission_spectra.cpp", "w" );
+    fprintf( fp, "static float s_emissionSpectraRGB[][3] = {\n" );
+    for( size_t i = 0; i < spectra.size(); i++ ) {
+        if ( !loaded[i] ) continue;
+        auto& s = spectra[i];
+        fprintf( fp, "    { %.8ff, %.8ff, %.8ff }, // %s\n", s.rgb.r, s.rgb.g, s.rgb.b, s.name.c_str() );
+    }
+    fprintf( fp, "};\n" );
+    fclose( fp );
+
+    // Output to file as CSV!
+    fp = fopen( "output/emission_spectra.csv", "w" );
+    for( size_t i = 0; i < spectra.size(); i++ ) {
+        if ( !loaded[i] ) continue;
+        auto& s = spectra[i];
+        fprintf( fp, "%s,%.8f,%.8f,%.8f\n", s.name.c_str(), s.rgb.r, s.rgb.g, s.rgb.b );
+    }
+    fclose( fp );
+}
+
+void bake_emissionSpectra( BakeGraph& graph, const std::vector< std::string >& spectrumFiles, SpectrumColorSpace colorSpace )
+{
+    baker_addJob( graph, "emission_spectra", [=]() { spectrum_BakeEmissionSpectra( spectrumFiles, colorSpace ); } );
+}
@@ -18,8 +18,12 @@
 */
 
 #include <functional>
+#include <fstream>
+#include <memory>
+#include <cstdio>
 #include "common.h"
 #include "subsurface.h"
+#include <csv-parser/parser.hpp>
 using namespace glm;
 
 // ref: https://en.wikipedia.org/wiki/Gaussian_function
@@ -68,46 +72,461 @@ vec3 pss_NVIDIA_SumOfGaussiansFit( float dist, float w )
     return totalWeight;
 }
 
-static std::function< vec3( float dist, float w ) > s_sssConvKernel = nullptr;
+typedef std::function< vec3( float dist, float w ) > PssKernel;
 
-vec4 pss_BakeCurvatureTable( float x, float y )
+#define PSS_DIST_BINS 4096
+#define PSS_DIST_MIN 1e-7f
+#define PSS_DIST_MAX 2.0f
+
+// Everything about the convolution that doesn't depend on the kernel or its width: the cos( theta ) samples
+// being convolved, and for every table column / sample pair which distance bin their distance falls in.
+// Bins are log spaced, so the narrowest kernels at low widths are still resolved.
+//
+// The penumbra tables convolve a shadow edge instead of N.L, reusing the same samples as positions across
+// the penumbra. Those are cosine spaced, so they carry their spacing as an integration weight.
+//
+struct PssSamples
+{
+    int res;
+    int numSamples;
+    std::vector< float > NdotL;           // Per sample.
+    std::vector< float > irradiance;      // Per sample, saturate( NdotL ).
+    std::vector< float > binDist;         // Per bin, the distance the kernel is evaluated at.
+    std::vector< int > bin;               // Per table column x sample.
+    std::vector< float > binFrac;         // Per table column x sample.
+
+    std::vector< float > shadow;          // Per sample, sharp shadow at NdotL as penumbra position.
+    std::vector< float > shadowDensity;   // Per sample.
+    std::vector< int > shadowBin;         // Per penumbra table column x sample.
+    std::vector< float > shadowBinFrac;   // Per penumbra table column x sample.
+};
+
+void pss_BinDistance( float dist, int& bin, float& frac )
+{
+    float t = log( max( dist, PSS_DIST_MIN ) / PSS_DIST_MIN ) / log( PSS_DIST_MAX / PSS_DIST_MIN ) * float( PSS_DIST_BINS - 1 );
+    bin = min( int( t ), PSS_DIST_BINS - 2 );
+    frac = t - float( bin );
+}
+
+// Penumbra position of a penumbra table column, over [ -1, 1 ]. The incoming shadow is sharpened to a linear
+// ramp over the middle half of the table, leaving room on both sides for the scattering to bleed into.
+//
+float pss_PenumbraPosition( float x )
+{
+    return x * 2.0f - 1.0f;
+}
+
+float pss_PenumbraShadow( float position )
+{
+    return clamp( position + 0.5f, 0.0f, 1.0f );
+}
+
+PssSamples pss_PrecomputeSamples( int res, int numSamples )
+{
+    BAKER_TRACE_SCOPE( "precompute subsurface samples" );
+    PssSamples s;
+    s.res = res;
+    s.numSamples = numSamples;
+    s.NdotL.resize( numSamples );
+    s.irradiance.resize( numSamples );
+    s.shadow.resize( numSamples );
+    s.shadowDensity.resize( numSamples );
+    for( int i = 0; i < numSamples; i++ ) {
+        float theta2 = float( i ) / float ( numSamples - 1 ) * PI;
+        s.NdotL[i] = cos( theta2 );
+        s.irradiance[i] = clamp( s.NdotL[i], 0.0f, 1.0f );
+        s.shadow[i] = pss_PenumbraShadow( s.NdotL[i] );
+        s.shadowDensity[i] = sin( theta2 );
+    }
+
+    s.binDist.resize( PSS_DIST_BINS );
+    for( int b = 0; b < PSS_DIST_BINS; b++ ) {
+        s.binDist[b] = PSS_DIST_MIN * pow( PSS_DIST_MAX / PSS_DIST_MIN, float( b ) / float( PSS_DIST_BINS - 1 ) );
+    }
+
+    s.bin.resize( res * numSamples );
+    s.binFrac.resize( res * numSamples );
+    s.shadowBin.resize( res * numSamples );
+    s.shadowBinFrac.resize( res * numSamples );
+    for( int x = 0; x < res; x++ ) {
+        float NdotL = cos( float( x ) / ( res - 1 ) * PI );
+        float position = pss_PenumbraPosition( float( x ) / ( res - 1 ) );
+        for( int i = 0; i < numSamples; i++ ) {
+            int idx = x * numSamples + i;
+            pss_BinDistance( abs( s.NdotL[i] - NdotL ), s.bin[idx], s.binFrac[idx] );
+            pss_BinDistance( abs( s.NdotL[i] - position ), s.shadowBin[idx], s.shadowBinFrac[idx] );
+        }
+    }
+    return s;
+}
+
+// Samples summed in plain floats before each compensated add in the convolution. Keeps the rounding error of the
+// 2048 sample sums near that of a short block, without paying for compensation in the innermost loop.
+#define PSS_SUM_BLOCK 64
+
+// Convolves one table column for all kernels, given the kernel weights per distance bin for the column's width.
+// Reference bakes use BakerDoubleSum with blocks of 1, so every sample goes straight into the double sums.
+//
+template< bool hasDensity, typename Sum, int blockSize >
+void pss_ConvolveColumn( const PssSamples& s, const std::vector< vec3 >& weights, int j,
+                         const std::vector< int >& bins, const std::vector< float >& binFracs,
+                         const std::vector< float >& values, const std::vector< float >& density,
+                         std::vector< std::vector< vec4 > >& tables )
+{
+    int res = s.res;
+    int numSamples = s.numSamples;
+    int numKernels = int( tables.size() );
+    std::vector< Sum > sum( numKernels ), norm( numKernels );
+    std::vector< vec3 > blockSum( numKernels ), blockNorm( numKernels );
+    for( int i = 0; i < res; i++ ) {
+        std::fill( sum.begin(), sum.end(), Sum() );
+        std::fill( norm.begin(), norm.end(), Sum() );
+
+        const int* bin = &bins[i * numSamples];
+        const float* frac = &binFracs[i * numSamples];
+        for( int block = 0; block < numSamples; block += blockSize ) {
+            std::fill( blockSum.begin(), blockSum.end(), vec3( 0.0f ) );
+            std::fill( blockNorm.begin(), blockNorm.end(), vec3( 0.0f ) );
+            int blockEnd = min( block + blockSize, numSamples );
+            for( int n = block; n < blockEnd; n++ ) {
+                for( int k = 0; k < numKernels; k++ ) {
+                    const vec3* kw = &weights[k * PSS_DIST_BINS + bin[n]];
+                    vec3 weight = mix( kw[0], kw[1], frac[n] );
+                    if ( hasDensity ) weight *= density[n];
+                    blockSum[k] += weight * values[n];
+                    blockNorm[k] += weight;
+                }
+            }
+            for( int k = 0; k < numKernels; k++ ) {
+                sum[k].add( blockSum[k] );
+                norm[k].add( blockNorm[k] );
+            }
+        }
+
+        for( int k = 0; k < numKernels; k++ ) {
+            vec3 c = sum[k].value() / norm[k].value();
+            c.x = pow( c.x, 1.0f / 2.2f );
+            c.y = pow( c.y, 1.0f / 2.2f );
+            c.z = pow( c.z, 1.0f / 2.2f );
+            tables[k][i * res + j] = vec4( c, 1.0f );
+        }
+    }
+    baker_countSamples( uint64_t( res ) * numSamples * numKernels );
+}
+
+// Bakes the curvature and penumbra tables for several kernels in one pass. Each table column is a single kernel
+// width, so every kernel is only evaluated once per distance bin per column, and the convolution over the
+// samples reduces to table lookups shared between all kernels and both tables.
+//
+void pss_BakeCurvatureTables( const PssSamples& s, const std::vector< PssKernel >& kernels,
+                              std::vector< std::vector< vec4 > >& curvatureTables,
+                              std::vector< std::vector< vec4 > >& penumbraTables )
+{
+    BAKER_TRACE_SCOPE( "convolve subsurface kernels" );
+    int res = s.res;
+    int numKernels = int( kernels.size() );
+    curvatureTables.assign( numKernels, std::vector< vec4 >( res * res ) );
+    penumbraTables.assign( numKernels, std::vector< vec4 >( res * res ) );
+
+    baker_parallelFor( res, [&]( int j ) {
+        float w = 0.001f + float( j ) / ( res - 1 ) * 0.5f;
+
+        std::vector< vec3 > weights( numKernels * PSS_DIST_BINS );
+        for( int k = 0; k < numKernels; k++ ) {
+            for( int b = 0; b < PSS_DIST_BINS; b++ ) {
+                weights[k * PSS_DIST_BINS + b] = kernels[k]( s.binDist[b], w );
+            }
+        }
+
+        if ( baker_referenceSums() ) {
+            pss_ConvolveColumn< false, BakerDoubleSum< vec3 >, 1 >( s, weights, j, s.bin, s.binFrac, s.irradiance, s.shadowDensity, curvatureTables );
+            pss_ConvolveColumn< true, BakerDoubleSum< vec3 >, 1 >( s, weights, j, s.shadowBin, s.shadowBinFrac, s.shadow, s.shadowDensity, penumbraTables );
+        } else {
+            pss_ConvolveColumn< false, BakerSum< vec3 >, PSS_SUM_BLOCK >( s, weights, j, s.bin, s.binFrac, s.irradiance, s.shadowDensity, curvatureTables );
+            pss_ConvolveColumn< true, BakerSum< vec3 >, PSS_SUM_BLOCK >( s, weights, j, s.shadowBin, s.shadowBinFrac, s.shadow, s.shadowDensity, penumbraTables );
+        }
+    } );
+}
+
+void pss_BakeKernelTables( int res, int numSamples, std::vector< std::vector< vec4 > >& curvatureTables,
+                           std::vector< std::vector< vec4 > >& penumbraTables )
+{
+    std::vector< PssKernel > kernels = { pss_StandardGaussian, pss_Smoothstep, pss_NVIDIA_SumOfGaussiansFit };
+    auto samples = pss_PrecomputeSamples( res, numSamples );
+    pss_BakeCurvatureTables( samples, kernels, curvatureTables, penumbraTables );
+}
+
+// Radial diffusion profiles are given as r * R( r ), the profile weighted by the ring circumference, which
+// stays finite at r = 0 for profiles like Burley's. Channels are normalised separately so scale doesn't matter.
+// The extent is the radius the profile's near field varies over, which the innermost rings have to resolve.
+//
+struct PssProfile
+{
+    std::function< vec3( float r ) > rR;
+    float extent; // mm.
+};
+
+#define PSS_NUM_RINGS 1024
+#define PSS_RING_MIN_RADIUS 1e-2f // Innermost ring, relative to the profile extent.
+#define PSS_NUM_ANGLES 2048
+#define PSS_ANGLE_MIN 1e-7f
+#define PSS_MIN_CURVATURE 1e-4f
+
+// Normalized diffusion by Burley, with per-channel scattering distance d.
+//
+// ref: "Approximate Reflectance Profiles for Efficient Subsurface Scattering" by Christensen and Burley
+//
+PssProfile pss_BurleyProfile( vec3 d )
+{
+    PssProfile profile;
+    profile.rR = [d]( float r ) {
+        vec3 s = 1.0f / d;
+        return s * ( exp( -s * r ) + exp( -s * r / 3.0f ) );
+    };
+    profile.extent = min( d.x, min( d.y, d.z ) );
+    return profile;
+}
+
+// Reads radius ( mm ), then either a single profile value or one per RGB channel. Rows that don't parse, like
+// headers, are skipped. The profile holds its first value towards r = 0 and is zero past the last radius.
+// Its extent is the finest spacing the file resolves.
+//
+bool pss_LoadProfileCSV( std::string fileName, PssProfile& profile )
 {
-    float theta = x * PI;
-    float NdotL = cos( theta );
-    float w = 0.001f + y * 0.5f;
+    std::ifstream f( fileName );
+    if ( !f.is_open() ) {
+        return false;
+    }
+
+    std::vector< vec4 > points;
+    aria::csv::CsvParser parser( f );
+    for( auto& row : parser ) {
+        if ( row.size() < 2 ) continue;
+        try {
+            float r = std::stof( row[0] );
+            vec3 R = row.size() < 4 ? vec3( std::stof( row[1] ) ) : vec3( std::stof( row[1] ), std::stof( row[2] ), std::stof( row[3] ) );
+            points.push_back( vec4( r, R ) );
+        } catch ( ... ) {
+            continue;
+        }
+    }
+    if ( points.size() < 2 ) {
+        return false;
+    }
+    std::sort( points.begin(), points.end(), []( vec4 a, vec4 b ) { return a.x < b.x; } );
+
+    profile.extent = points.back().x - points.front().x;
+    if ( points.front().x > 0.0f ) profile.extent = min( profile.extent, points.front().x );
+    for( size_t i = 1; i < points.size(); i++ ) {
+        float gap = points[i].x - points[i - 1].x;
+        if ( gap > 0.0f ) profile.extent = min( profile.extent, gap );
+    }
+    if ( !( profile.extent > 0.0f ) ) {
+        return false;
+    }
 
-    vec3 sum;
-    vec3 norm;
+    profile.rR = [points]( float r ) {
+        if ( r > points.back().x ) return vec3( 0.0f );
+        if ( r <= points.front().x ) return r * max( vec3( points.front() ), vec3( 0.0f ) );
+        auto b = std::lower_bound( points.begin(), points.end(), r, []( vec4 p, float r ) { return p.x < r; } );
+        auto a = b - 1;
+        float t = ( b->x - a->x ) > 0.0f ? ( r - a->x ) / ( b->x - a->x ) : 0.0f;
+        return r * max( mix( vec3( *a ), vec3( *b ), t ), vec3( 0.0f ) );
+    };
+    return true;
+}
 
-    const int NUM_SAMPLES = 2048;
-    for( int i = 0; i < NUM_SAMPLES; i++ ) {
-        float x2 = float( i ) / float ( NUM_SAMPLES - 1 );
-        float theta2 = x2 * PI;
-        float NdotL2 = cos( theta2 );
+// Average of saturate( a + b cos( psi ) ) over psi in [ 0, 2 PI ), b >= 0.
+//
+float pss_RingAverageIrradiance( float a, float b )
+{
+    if ( a >= b ) return a;
+    if ( a <= -b ) return 0.0f;
+    float psi = acos( -a / b );
+    return ( a * psi + b * sin( psi ) ) / PI;
+}
 
-        float dist = abs( NdotL2 - NdotL );
-        vec3 weight = s_sssConvKernel( dist, w );
-        
-        sum += weight * clamp( NdotL2, 0.0f, 1.0f );
-        norm += weight;
+// The shading point is integrated over rings of points on a sphere at the same angle phi from it, rather than
+// only along the great circle through the light. Everything but the profile weight of each ring is independent
+// of curvature and profile: on the unit sphere a ring at phi sees N.L = cos( phi ) cos( theta ) +
+// sin( phi ) sin( theta ) cos( psi ), and the ring average of that is shared by every slice and profile.
+// It is tabulated over log spaced angles and interpolated at each column's rings.
+//
+struct PssRingSamples
+{
+    int res;
+    std::vector< float > phi;        // Per angle.
+    std::vector< float > irradiance; // Per table column x angle.
+};
+
+PssRingSamples pss_PrecomputeRings( int res )
+{
+    PssRingSamples s;
+    s.res = res;
+    s.phi.resize( PSS_NUM_ANGLES );
+    s.phi[0] = 0.0f;
+    for( int n = 1; n < PSS_NUM_ANGLES; n++ ) {
+        s.phi[n] = PSS_ANGLE_MIN * pow( PI / PSS_ANGLE_MIN, float( n - 1 ) / float( PSS_NUM_ANGLES - 2 ) );
     }
-    
-    sum /= norm;
-    sum.x = pow( sum.x, 1.0f / 2.2f );
-    sum.y = pow( sum.y, 1.0f / 2.2f );
-    sum.z = pow( sum.z, 1.0f / 2.2f );
 
-    return vec4( sum, 1.0f );
+    s.irradiance.resize( res * PSS_NUM_ANGLES );
+    baker_parallelFor( res, [&]( int i ) {
+        float theta = float( i ) / ( res - 1 ) * PI;
+        for( int n = 0; n < PSS_NUM_ANGLES; n++ ) {
+            float a = cos( s.phi[n] ) * cos( theta );
+            float b = sin( s.phi[n] ) * sin( theta );
+            s.irradiance[i * PSS_NUM_ANGLES + n] = pss_RingAverageIrradiance( a, b );
+        }
+    } );
+    return s;
 }
 
-void bake_subsurface()
+void pss_RingAngle( float phi, int& index, float& frac )
+{
+    if ( phi < PSS_ANGLE_MIN ) {
+        index = 0;
+        frac = phi / PSS_ANGLE_MIN;
+        return;
+    }
+    float t = log( phi / PSS_ANGLE_MIN ) / log( PI / PSS_ANGLE_MIN ) * float( PSS_NUM_ANGLES - 2 ) + 1.0f;
+    index = min( int( t ), PSS_NUM_ANGLES - 2 );
+    frac = min( t - float( index ), 1.0f );
+}
+
+// Rings are log spaced in distance from a small fraction of the profile extent out to the antipode, so a
+// narrow profile is resolved however flat the surface. On a sphere of radius R the ring at distance r lies at
+// angle phi = 2 asin( r / 2 R ), and its area is r dr, so r * R( r ) times the trapezoid width in r is the
+// ring weight.
+//
+template< typename Sum >
+void pss_ProfileColumn( const PssRingSamples& s, const PssProfile& profile, const PssProfileSettings& settings, int k, int j, std::vector< vec4 >& slice )
 {
-    s_sssConvKernel = pss_StandardGaussian;
-    baker_imageFunction2D( pss_BakeCurvatureTable, 256, "output/subsurface_gaussian.png" );
-    
-    s_sssConvKernel = pss_Smoothstep;
-    baker_imageFunction2D( pss_BakeCurvatureTable, 256, "output/subsurface_smoothstep.png" );
+    int res = s.res;
+    int numSlices = max( settings.numSlices, 1 );
+    float scale = float( k + 1 ) / float( numSlices );
+    float curvature = max( float( j ) / ( res - 1 ) * settings.maxCurvature, PSS_MIN_CURVATURE );
+    float radius = 1.0f / curvature;
+    float maxDist = 2.0f * radius;
+    float minDist = PSS_RING_MIN_RADIUS * min( profile.extent * scale, maxDist );
 
-    s_sssConvKernel = pss_NVIDIA_SumOfGaussiansFit;
-    baker_imageFunction2D( pss_BakeCurvatureTable, 256, "output/subsurface_penner.png" );
-}
\ No newline at end of file
+    std::vector< float > dist( PSS_NUM_RINGS );
+    dist[0] = 0.0f;
+    for( int n = 1; n < PSS_NUM_RINGS; n++ ) {
+        dist[n] = minDist * pow( maxDist / minDist, float( n - 1 ) / float( PSS_NUM_RINGS - 2 ) );
+    }
+
+    std::vector< vec3 > weights( PSS_NUM_RINGS );
+    std::vector< int > angle( PSS_NUM_RINGS );
+    std::vector< float > angleFrac( PSS_NUM_RINGS );
+    Sum weightSum;
+    for( int n = 0; n < PSS_NUM_RINGS; n++ ) {
+        float lo = dist[max( n - 1, 0 )];
+        float hi = dist[min( n + 1, PSS_NUM_RINGS - 1 )];
+        weights[n] = profile.rR( dist[n] / scale ) * ( hi - lo ) * 0.5f;
+        weightSum.add( weights[n] );
+        pss_RingAngle( 2.0f * asin( min( dist[n] / maxDist, 1.0f ) ), angle[n], angleFrac[n] );
+    }
+    vec3 norm = weightSum.value();
+
+    for( int i = 0; i < res; i++ ) {
+        const float* irradiance = &s.irradiance[i * PSS_NUM_ANGLES];
+        Sum irradianceSum;
+        for( int n = 0; n < PSS_NUM_RINGS; n++ ) {
+            float E = mix( irradiance[angle[n]], irradiance[angle[n] + 1], angleFrac[n] );
+            irradianceSum.add( weights[n] * E );
+        }
+        vec3 sum = irradianceSum.value();
+
+        // A profile with no weight at this scale doesn't scatter at all.
+        float NdotL = clamp( cos( float( i ) / ( res - 1 ) * PI ), 0.0f, 1.0f );
+        vec3 c;
+        for( int ch = 0; ch < 3; ch++ ) {
+            c[ch] = norm[ch] > 0.0f ? pow( sum[ch] / norm[ch], 1.0f / 2.2f ) : pow( NdotL, 1.0f / 2.2f );
+        }
+        slice[i * res + j] = vec4( c, 1.0f );
+    }
+}
+
+void pss_BakeProfileTables( const PssRingSamples& s, const PssProfile& profile, const PssProfileSettings& settings, std::vector< std::vector< vec4 > >& slices )
+{
+    BAKER_TRACE_SCOPE( "integrate subsurface profile" );
+    int res = s.res;
+    int numSlices = max( settings.numSlices, 1 );
+    slices.assign( numSlices, std::vector< vec4 >( res * res ) );
+
+    baker_parallelFor( numSlices * res, [&]( int idx ) {
+        int k = idx / res;
+        int j = idx % res;
+        if ( baker_referenceSums() ) {
+            pss_ProfileColumn< BakerDoubleSum< vec3 > >( s, profile, settings, k, j, slices[k] );
+        } else {
+            pss_ProfileColumn< BakerSum< vec3 > >( s, profile, settings, k, j, slices[k] );
+        }
+    } );
+}
+
+void pss_BakeBurleyTables( int res, const PssProfileSettings& settings, std::vector< std::vector< vec4 > >& slices )
+{
+    auto rings = pss_PrecomputeRings( res );
+    pss_BakeProfileTables( rings, pss_BurleyProfile( settings.scatterDistance ), settings, slices );
+}
+
+void pss_WriteProfileSlices( const std::vector< std::vector< vec4 > >& slices, int res, std::string baseName )
+{
+    for( int k = 0; k < int( slices.size() ); k++ ) {
+        char outputFileName[512];
+        snprintf( outputFileName, sizeof( outputFileName ), "output/%s_%02d.png", baseName.c_str(), k );
+        baker_writeImage2D( slices[k], res, outputFileName );
+    }
+}
+
+// The kernel tables and the Burley profile slices are independent jobs.
+//
+void bake_subsurface( BakeGraph& graph, const PssProfileSettings& settings )
+{
+    const int res = 256;
+    baker_addJob( graph, "subsurface", [=]() {
+        const char* kernelNames[] = { "gaussian", "smoothstep", "penner" };
+
+        printf( "Baking subsurface curvature and penumbra tables ...\n" );
+        std::vector< std::vector< vec4 > > tables, penumbraTables;
+        pss_BakeKernelTables( res, PSS_NUM_SAMPLES, tables, penumbraTables );
+
+        for( int k = 0; k < int( tables.size() ); k++ ) {
+            baker_writeImage2D( tables[k], res, std::string( "output/subsurface_" ) + kernelNames[k] + ".png" );
+            baker_writeImage2D( penumbraTables[k], res, std::string( "output/subsurface_penumbra_" ) + kernelNames[k] + ".png" );
+        }
+    } );
+
+    baker_addJob( graph, "subsurface_burley", [=]() {
+        printf( "Baking %d Burley diffusion profile slices ...\n", max( settings.numSlices, 1 ) );
+        std::vector< std::vector< vec4 > > tables;
+        pss_BakeBurleyTables( res, settings, tables );
+        pss_WriteProfileSlices( tables, res, "subsurface_burley" );
+    } );
+}
+
+// The ring samples are shared by every profile, so they are one job the per-profile jobs wait on.
+//
+void bake_subsurfaceProfiles( BakeGraph& graph, const std::vector< std::string >& profileFiles, const PssProfileSettings& settings )
+{
+    namespace fs = std::experimental::filesystem;
+    const int res = 256;
+    auto rings = std::make_shared< PssRingSamples >();
+    int ringsJob = baker_addJob( graph, "subsurface_rings", [=]() { *rings = pss_PrecomputeRings( res ); } );
+
+    for( auto& fileName : profileFiles ) {
+        baker_addJob( graph, "subsurface_" + fs::path( fileName ).stem().u8string(), [=]() {
+            PssProfile profile;
+            if ( !pss_LoadProfileCSV( fileName, profile ) ) {
+                printf( "    Failed to load diffusion profile %s, skipping.\n", fileName.c_str() );
+                return;
+            }
+
+            printf( "Baking %d diffusion profile slices for %s ...\n", max( settings.numSlices, 1 ), fileName.c_str() );
+            std::vector< std::vector< vec4 > > slices;
+            pss_BakeProfileTables( *rings, profile, settings, slices );
+            pss_WriteProfileSlices( slices, res, "subsurface_" + fs::path( fileName ).stem().u8string() );
+        }, { ringsJob } );
+    }
+}
@@ -20,4 +20,26 @@
 #pragma once
 #include "common.h"
 
-void bake_subsurface();
\ No newline at end of file
+#define PSS_NUM_SAMPLES 2048
+
+// Diffusion profile tables are baked as a stack of slices over scattering distance. Slice k scales the profile
+// radius by ( k + 1 ) / numSlices, so the last slice is the profile as given. Within a slice x is the angle
+// to the light over [ 0, PI ] like the curvature tables, and y is the surface curvature over [ 0, maxCurvature ].
+//
+struct PssProfileSettings
+{
+    glm::vec3 scatterDistance = glm::vec3( 0.7f, 0.27f, 0.14f ); // Burley d per channel, mm. Roughly skin.
+    float maxCurvature = 0.5f; // 1 / mm.
+    int numSlices = 8;
+};
+
+// Curvature and penumbra tables for the gaussian, smoothstep and penner kernels, in that order. Each convolves
+// numSamples angles per texel.
+void pss_BakeKernelTables( int res, int numSamples, std::vector< std::vector< glm::vec4 > >& curvatureTables,
+                           std::vector< std::vector< glm::vec4 > >& penumbraTables );
+
+// One res x res table per slice of the Burley normalized diffusion profile.
+void pss_BakeBurleyTables( int res, const PssProfileSettings& settings, std::vector< std::vector< glm::vec4 > >& slices );
+
+void bake_subsurface( BakeGraph& graph, const PssProfileSettings& settings );
+void bake_subsurfaceProfiles( BakeGraph& graph, const std::vector< std::string >& profileFiles, const PssProfileSettings& settings );
\ No newline at end of file
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+#
+# Scripted stdin test of cancelling bakes in pbr_baker --serve, see server.h for the protocol.
+#
+#   python3 tests/serve_cancel.py [path/to/pbr_baker]
+#
+# Exits with 1 and prints what went wrong if the server makes outputs of a cancelled bake ready, lets a cancel
+# leak into a later request, doesn't refine long bakes while they run, or doesn't answer in time.
+#
+import queue
+import subprocess
+import sys
+import threading
+import time
+
+BAKER = sys.argv[1] if len( sys.argv ) > 1 else "./pbr_baker"
+TIMEOUT = 120.0
+CANCEL_SECONDS = 10.0
+RACES = 20
+
+SLOW = b"""[slow_sss]
+table = subsurface_gaussian
+resolution = 512
+samples = 8192
+[slow_brdf]
+table = env_brdf
+resolution = 512
+samples = 4096
+"""
+
+# Four blue noise channels ranked on two threads, so a cancel lands with some channels not started.
+NOISE = b"""[noise]
+table = blue_noise
+channels = rgba
+resolution = 256
+"""
+
+# Long enough for the refinements, every 0.5s by default, to show up before it's done.
+REFINED = b"""[refined]
+table = env_brdf
+resolution = 256
+samples = 4096
+"""
+
+FAST = b"""[fast]
+table = brdf_Fd0
+resolution = 16
+"""
+
+server = subprocess.Popen( [ BAKER, "--serve", "--threads", "2" ], stdin = subprocess.PIPE, stdout = subprocess.PIPE,
+                           stderr = subprocess.DEVNULL )
+replies = queue.Queue()
+
+def read_replies():
+    while True:
+        line = server.stdout.readline()
+        if not line:
+            replies.put( None )
+            return
+        words = line.decode().split()
+        if words[0] == "tile":
+            width, height = int( words[5] ), int( words[6] )
+            channels = outputs[( int( words[1] ), int( words[2] ) )]
+            server.stdout.read( width * height * channels * 4 )
+            continue
+        if words[0] == "output":
+            outputs[( int( words[1] ), int( words[2] ) )] = int( words[5] )
+            continue
+        replies.put( words )
+
+outputs = {}
+threading.Thread( target = read_replies, daemon = True ).start()
+
+def send( data ):
+    server.stdin.write( data )
+    server.stdin.flush()
+
+# Waits for the final reply to request, returning it, the number of outputs made ready for it and the number of
+# refinements streamed before the first one was ready.
+def wait_for( request ):
+    streamed = 0
+    refined = 0
+    deadline = time.time() + TIMEOUT
+    while True:
+        try:
+            words = replies.get( timeout = max( 0.0, deadline - time.time() ) )
+        except queue.Empty:
+            fail( "no reply to request %d within %gs" % ( request, TIMEOUT ) )
+        if words is None:
+            fail( "server exited waiting for request %d" % request )
+        if int( words[1] ) != request:
+            fail( "unexpected reply %s waiting for request %d" % ( " ".join( words ), request ) )
+        if words[0] == "ready":
+            streamed += 1
+        elif words[0] == "refined":
+            refined += streamed == 0
+        else:
+            return words[0], streamed, refined
+
+def fail( message ):
+    print( "FAILED: " + message )
+    server.kill()
+    sys.exit( 1 )
+
+def expect( request, reply, maxOutputs = None, minRefined = 0 ):
+    got, streamed, refined = wait_for( request )
+    if got != reply:
+        fail( "request %d replied %s, expected %s" % ( request, got, reply ) )
+    if maxOutputs is not None and streamed > maxOutputs:
+        fail( "request %d made %d outputs ready after being cancelled" % ( request, streamed ) )
+    if refined < minRefined:
+        fail( "request %d streamed %d refinements before its output was ready" % ( request, refined ) )
+    print( "request %d: %s, %d outputs, %d refinements" % ( request, got, streamed, refined ) )
+
+request = 0
+
+# Cancel right behind the bake, racing the worker picking the request up and starting it. Whether it lands
+# while the request is queued, before its bake starts or during it, nothing may be streamed.
+for race in range( RACES ):
+    send( SLOW + b"bake\ncancel\n" )
+    request += 1
+    expect( request, "cancelled", 0 )
+
+# The cancel must not leak into the next request.
+send( FAST + b"bake\n" )
+request += 1
+expect( request, "done" )
+
+# A long BRDF bake streams refinements while it runs.
+send( REFINED + b"bake\n" )
+request += 1
+expect( request, "done", minRefined = 1 )
+
+# Cancel while the bake is running.
+send( SLOW + b"bake\n" )
+request += 1
+time.sleep( 0.5 )
+start = time.time()
+send( b"cancel\n" )
+expect( request, "cancelled" )
+if time.time() - start > CANCEL_SECONDS:
+    fail( "cancel took %.2fs" % ( time.time() - start ) )
+
+# Cancel a multi-channel noise bake part way through ranking its channels.
+send( NOISE + b"bake\n" )
+request += 1
+time.sleep( 0.5 )
+send( b"cancel\n" )
+expect( request, "cancelled", 0 )
+
+# A cancel with nothing running is dropped.
+send( b"cancel\n" + FAST + b"bake\n" )
+request += 1
+expect( request, "done" )
+
+send( b"quit\n" )
+if server.wait( timeout = TIMEOUT ) != 0:
+    fail( "server exited with %d" % server.returncode )
+print( "OK" )
@@ -0,0 +1,197 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "trace.h"
+
+#include <memory>
+#include <mutex>
+
+struct BakerTraceEvent
+{
+    std::string name;
+    char phase;         // X for a scope, C for a counter value.
+    int64_t start;      // Nanoseconds since the trace started.
+    int64_t duration;   // Or the counter value.
+};
+
+// Each thread records into its own buffer; the lock is only ever contended while the trace is being written.
+//
+struct BakerTraceBuffer
+{
+    std::mutex mutex;
+    std::vector< BakerTraceEvent > events;
+    int thread;
+};
+
+struct BakerTrace
+{
+    std::atomic< bool > tracing;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mutex;
+    std::vector< std::shared_ptr< BakerTraceBuffer > > buffers;
+    std::vector< BakerCounter* > counters;
+    uint64_t baseSamples = 0;
+    uint64_t baseTexels = 0;
+};
+
+// Counters are constructed during static initialization, possibly before anything else in this file.
+//
+static BakerTrace& baker_trace()
+{
+    static BakerTrace s_trace;
+    return s_trace;
+}
+
+static int64_t baker_traceNow()
+{
+    return int64_t( std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - baker_trace().start ).count() );
+}
+
+static BakerTraceBuffer& baker_traceBuffer()
+{
+    thread_local std::shared_ptr< BakerTraceBuffer > t_buffer;
+    if ( !t_buffer ) {
+        auto& trace = baker_trace();
+        std::lock_guard< std::mutex > lock( trace.mutex );
+        t_buffer = std::make_shared< BakerTraceBuffer >();
+        t_buffer->thread = int( trace.buffers.size() );
+        trace.buffers.push_back( t_buffer );
+    }
+    return *t_buffer;
+}
+
+static void baker_traceRecord( const std::string& name, char phase, int64_t start, int64_t duration )
+{
+    auto& buffer = baker_traceBuffer();
+    std::lock_guard< std::mutex > lock( buffer.mutex );
+    buffer.events.push_back( { name, phase, start, duration } );
+}
+
+bool baker_tracing()
+{
+    return baker_trace().tracing.load( std::memory_order_relaxed );
+}
+
+BakerCounter::BakerCounter( const char* name ) : name( name ), value( 0 )
+{
+    auto& trace = baker_trace();
+    std::lock_guard< std::mutex > lock( trace.mutex );
+    trace.counters.push_back( this );
+}
+
+BakerTraceScope::BakerTraceScope( const char* name ) : name( name ), start( baker_tracing() ? baker_traceNow() : -1 )
+{
+}
+
+BakerTraceScope::BakerTraceScope( const std::string& name ) : name( nullptr ), start( baker_tracing() ? baker_traceNow() : -1 )
+{
+    if ( start >= 0 ) dynamicName = name;
+}
+
+BakerTraceScope::~BakerTraceScope()
+{
+    if ( start >= 0 && baker_tracing() ) {
+        baker_traceRecord( name ? std::string( name ) : dynamicName, 'X', start, baker_traceNow() - start );
+    }
+}
+
+void baker_traceCounters()
+{
+    if ( !baker_tracing() ) {
+        return;
+    }
+    auto& trace = baker_trace();
+    int64_t now = baker_traceNow();
+    baker_traceRecord( "samples", 'C', now, int64_t( baker_stats().samples - trace.baseSamples ) );
+    baker_traceRecord( "texels written", 'C', now, int64_t( baker_stats().texels - trace.baseTexels ) );
+    for( auto counter : trace.counters ) {
+        baker_traceRecord( counter->name, 'C', now, int64_t( counter->value.load() ) );
+    }
+}
+
+void baker_startTrace()
+{
+    auto& trace = baker_trace();
+    std::lock_guard< std::mutex > lock( trace.mutex );
+    for( auto& buffer : trace.buffers ) {
+        std::lock_guard< std::mutex > bufferLock( buffer->mutex );
+        buffer->events.clear();
+    }
+    for( auto counter : trace.counters ) {
+        counter->value = 0;
+    }
+    trace.baseSamples = baker_stats().samples;
+    trace.baseTexels = baker_stats().texels;
+    trace.start = std::chrono::steady_clock::now();
+    trace.tracing = true;
+}
+
+std::string baker_traceEscape( const std::string& s )
+{
+    std::string escaped;
+    for( char c : s ) {
+        if ( c == '"' || c == '\\' ) escaped += '\\';
+        if ( uint8_t( c ) >= 0x20 ) escaped += c;
+    }
+    return escaped;
+}
+
+void baker_stopTrace( std::string outputFileName )
+{
+    baker_traceCounters();
+    auto& trace = baker_trace();
+    trace.tracing = false;
+#if !BAKER_TRACE
+    printf( "Built without BAKER_TRACE, %s only has the final counters.\n", outputFileName.c_str() );
+#endif
+
+    FILE* fp = fopen( outputFileName.c_str(), "w" );
+    if ( !fp ) {
+        printf( "Could not write trace %s.\n", outputFileName.c_str() );
+        return;
+    }
+
+    // Timestamps are in microseconds.
+    size_t numEvents = 0;
+    const char* separator = "";
+    fprintf( fp, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [\n" );
+    std::lock_guard< std::mutex > lock( trace.mutex );
+    for( auto& buffer : trace.buffers ) {
+        std::lock_guard< std::mutex > bufferLock( buffer->mutex );
+        if ( buffer->events.empty() ) continue;
+        fprintf( fp, "%s    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": { \"name\": \"thread %d\" } }",
+                 separator, buffer->thread, buffer->thread );
+        separator = ",\n";
+        for( auto& event : buffer->events ) {
+            auto name = baker_traceEscape( event.name );
+            if ( event.phase == 'X' ) {
+                fprintf( fp, ",\n    { \"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f }",
+                         name.c_str(), buffer->thread, event.start * 1e-3, event.duration * 1e-3 );
+            } else {
+                fprintf( fp, ",\n    { \"name\": \"%s\", \"ph\": \"C\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"args\": { \"value\": %lld } }",
+                         name.c_str(), buffer->thread, event.start * 1e-3, (long long)event.duration );
+            }
+            numEvents++;
+        }
+    }
+    fprintf( fp, "\n  ]\n}\n" );
+    fclose( fp );
+    printf( "Trace of %zu events written to %s.\n", numEvents, outputFileName.c_str() );
+}
@@ -0,0 +1,70 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Timeline tracing of bakes, written as Chrome trace JSON ( chrome://tracing or ui.perfetto.dev ) with a track per
+// thread. Scopes time a block and counters add up events like rejected samples; both only record between
+// baker_startTrace and baker_stopTrace, costing a flag check otherwise, and compile away entirely with
+// BAKER_TRACE defined to 0. Counter values are sampled onto the timeline after every bake job.
+//
+#ifndef BAKER_TRACE
+#define BAKER_TRACE 1
+#endif
+
+void baker_startTrace();
+void baker_stopTrace( std::string outputFileName );
+bool baker_tracing();
+
+struct BakerCounter
+{
+    explicit BakerCounter( const char* name );
+    const char* name;
+    std::atomic< uint64_t > value;
+};
+
+struct BakerTraceScope
+{
+    explicit BakerTraceScope( const char* name );
+    explicit BakerTraceScope( const std::string& name );
+    ~BakerTraceScope();
+
+    const char* name;
+    std::string dynamicName;
+    int64_t start;  // -1 when not tracing.
+};
+
+// Records the current counter values on the calling thread's track.
+void baker_traceCounters();
+
+#define BAKER_TRACE_JOIN2( a, b ) a##b
+#define BAKER_TRACE_JOIN( a, b ) BAKER_TRACE_JOIN2( a, b )
+
+#if BAKER_TRACE
+#define BAKER_TRACE_SCOPE( name ) BakerTraceScope BAKER_TRACE_JOIN( traceScope, __LINE__ )( name )
+#define BAKER_TRACE_COUNTER( variable, name ) static BakerCounter variable( name )
+#define BAKER_TRACE_COUNT( counter, n ) do { if ( baker_tracing() ) ( counter ).value += uint64_t( n ); } while ( 0 )
+#else
+#define BAKER_TRACE_SCOPE( name )
+#define BAKER_TRACE_COUNTER( variable, name )
+#define BAKER_TRACE_COUNT( counter, n ) ( void )( n )
+#endif
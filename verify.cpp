@@ -0,0 +1,189 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "common.h"
+#include "verify.h"
+#include "libpbrbaker.h"
+#include "gloss_normal.h"
+
+using namespace glm;
+
+// References are a header of magic and float count, then the floats in native byte order.
+#define VERIFY_MAGIC 0x46455242u
+
+struct VerifyTable
+{
+    std::string name;
+    std::vector< float > values;
+};
+
+struct VerifyErrors
+{
+    double maxAbs = 0.0;
+    double rms = 0.0;
+    int maxLsb = 0;
+};
+
+bool verify_LoadReference( std::string fileName, std::vector< float >& values )
+{
+    FILE* fp = fopen( fileName.c_str(), "rb" );
+    if ( !fp ) {
+        return false;
+    }
+    uint32_t header[2];
+    bool read = fread( header, sizeof( header ), 1, fp ) == 1 && header[0] == VERIFY_MAGIC;
+    if ( read ) {
+        values.resize( header[1] );
+        read = fread( values.data(), sizeof( float ), values.size(), fp ) == values.size();
+    }
+    fclose( fp );
+    return read;
+}
+
+bool verify_SaveReference( std::string fileName, const std::vector< float >& values )
+{
+    FILE* fp = fopen( fileName.c_str(), "wb" );
+    if ( !fp ) {
+        return false;
+    }
+    uint32_t header[2] = { VERIFY_MAGIC, uint32_t( values.size() ) };
+    bool written = fwrite( header, sizeof( header ), 1, fp ) == 1 &&
+                   fwrite( values.data(), sizeof( float ), values.size(), fp ) == values.size();
+    fclose( fp );
+    return written;
+}
+
+// Same rounding as baker_writeImage2D.
+int verify_Quantize( float x )
+{
+    return int( uint8_t( glm::clamp( x, 0.0f, 1.0f ) * 255.0f ) );
+}
+
+VerifyErrors verify_Compare( const std::vector< float >& baked, const std::vector< float >& reference )
+{
+    VerifyErrors errors;
+    double sumSquares = 0.0;
+    for( size_t i = 0; i < baked.size(); i++ ) {
+        double diff = std::abs( double( baked[i] ) - double( reference[i] ) );
+        if ( std::isnan( baked[i] ) || std::isnan( reference[i] ) ) {
+            diff = std::isnan( baked[i] ) == std::isnan( reference[i] ) ? 0.0 : INFINITY;
+        }
+        errors.maxAbs = max( errors.maxAbs, diff );
+        sumSquares += diff * diff;
+        errors.maxLsb = max( errors.maxLsb, std::abs( verify_Quantize( baked[i] ) - verify_Quantize( reference[i] ) ) );
+    }
+    errors.rms = sqrt( sumSquares / double( max( baked.size(), size_t( 1 ) ) ) );
+    return errors;
+}
+
+// Every manifest table at res x res, plus the outputs that aren't images: gloss normal lengths, Burley profile
+// slices and sample sequences. Scrambling tiles take minutes to optimize, so they are left out.
+//
+std::vector< VerifyTable > verify_BakeTables( PbrBaker* baker, int res )
+{
+    std::vector< VerifyTable > tables;
+    std::vector< ManifestOutput > outputs;
+    for( auto& name : manifest_TableNames() ) {
+        ManifestOutput output;
+        output.name = name;
+        output.resolution = res;
+        if ( manifest_CheckOutput( "verify", output ) ) {
+            outputs.push_back( output );
+            tables.push_back( { name, std::vector< float >( res * res * pbrbaker_ImageChannels( output ) ) } );
+        }
+    }
+    std::vector< float* > buffers;
+    for( auto& table : tables ) {
+        buffers.push_back( table.values.data() );
+    }
+    printf( "Baking %d tables at %dx%d ...\n", int( outputs.size() ), res, res );
+    pbrbaker_BakeImages( baker, outputs, buffers );
+
+    tables.push_back( { "gloss_normal_length", std::vector< float >( 256 ) } );
+    pbrbaker_GlossNormalLengths( baker, GLOSSNORMAL_SAMPLE_SIZE, tables.back().values.data() );
+
+    PssProfileSettings settings;
+    std::vector< vec4 > slices( max( settings.numSlices, 1 ) * res * res );
+    if ( pbrbaker_BurleyProfile( baker, settings, res, slices.data() ) ) {
+        tables.push_back( { "subsurface_burley", std::vector< float >( &slices[0][0], &slices[0][0] + slices.size() * 4 ) } );
+    }
+
+    const int numSamples = 256;
+    const int numDims = 4;
+    for( auto name : { "sobol", "owen", "r2", "hammersley" } ) {
+        std::vector< uint32_t > points( numSamples * numDims );
+        pbrbaker_SampleSequence( baker, name, numSamples, numDims, 0, points.data() );
+        tables.push_back( { std::string( "samples_" ) + name, {} } );
+        for( auto point : points ) {
+            tables.back().values.push_back( float( double( point ) / 4294967296.0 ) );
+        }
+    }
+    return tables;
+}
+
+bool bake_verify( const VerifySettings& settings )
+{
+    namespace fs = std::experimental::filesystem;
+    auto baker = pbrbaker_Create( settings.numThreads );
+    baker_setReferenceSums( settings.referenceSums );
+    auto tables = verify_BakeTables( baker, settings.resolution );
+    baker_setReferenceSums( false );
+    pbrbaker_Destroy( baker );
+
+    auto referenceFileName = [&]( const VerifyTable& table ) {
+        return ( fs::path( settings.referenceDir ) / ( table.name + "_" + std::to_string( settings.resolution ) + ".ref" ) ).u8string();
+    };
+
+    if ( settings.update ) {
+        std::error_code error;
+        fs::create_directories( settings.referenceDir, error );
+        int numWritten = 0;
+        for( auto& table : tables ) {
+            if ( verify_SaveReference( referenceFileName( table ), table.values ) ) {
+                numWritten++;
+            } else {
+                printf( "Could not write %s.\n", referenceFileName( table ).c_str() );
+            }
+        }
+        printf( "Wrote %d / %d references to %s.\n", numWritten, int( tables.size() ), settings.referenceDir.c_str() );
+        return numWritten == int( tables.size() );
+    }
+
+    int numFailed = 0;
+    printf( "\n%-32s %12s %12s %8s\n", "table", "max abs", "rms", "max lsb" );
+    for( auto& table : tables ) {
+        std::vector< float > reference;
+        if ( !verify_LoadReference( referenceFileName( table ), reference ) ) {
+            printf( "%-32s %12s %12s %8s  MISSING\n", table.name.c_str(), "-", "-", "-" );
+            numFailed++;
+            continue;
+        }
+        if ( reference.size() != table.values.size() ) {
+            printf( "%-32s %12s %12s %8s  SIZE CHANGED\n", table.name.c_str(), "-", "-", "-" );
+            numFailed++;
+            continue;
+        }
+        auto errors = verify_Compare( table.values, reference );
+        bool regressed = errors.maxLsb > settings.lsbTolerance || errors.maxAbs > settings.absTolerance;
+        printf( "%-32s %12.3g %12.3g %8d  %s\n", table.name.c_str(), errors.maxAbs, errors.rms, errors.maxLsb, regressed ? "REGRESSED" : "ok" );
+        numFailed += regressed;
+    }
+    printf( "\n%d / %d tables regressed against %s.\n", numFailed, int( tables.size() ), settings.referenceDir.c_str() );
+    return numFailed == 0;
+}
@@ -0,0 +1,44 @@
+/*
+    Copyright 2019 Xi Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+    associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial
+    portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+    NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+    OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include "common.h"
+
+// Golden reference regression check. Every table is baked small, in memory, and compared against float
+// references saved earlier with update set. The references at the default resolution are checked in under
+// reference/, and updated in the same commit as any change meant to move the tables. The tolerances absorb libm
+// differences between toolchains. Tables whose max 8-bit difference or max absolute difference are over the
+// tolerances are reported as regressions.
+//
+// Baking references with referenceSums set, into a separate directory, and verifying against them with zero
+// tolerances measures the rounding error of the float sums in the integrators.
+//
+struct VerifySettings
+{
+    std::string referenceDir = "reference";
+    int resolution = 32;
+    bool update = false;        // Overwrite the references instead of checking them.
+    int lsbTolerance = 1;       // Max difference in 8-bit steps, as images are written.
+    float absTolerance = 1e-3f; // Max absolute difference of the floats.
+    int numThreads = 0;
+    bool referenceSums = false; // Bake with the integrators summing in double precision.
+};
+
+// False if any table regressed or is missing its reference.
+bool bake_verify( const VerifySettings& settings );